@@ -0,0 +1,120 @@
+#include "airtime_accounting.h"
+#include <algorithm>
+
+void airtime_accounting::Window::add(double ms, qint64 timestampMs) {
+    qint64 start = timestampMs - timestampMs % SLOT_MS;
+    int index = int((start / SLOT_MS) % SLOTS);
+    if (startMs[index] > start) {
+        return; // too late for a minute this slot has moved past
+    }
+    if (startMs[index] != start) {
+        startMs[index] = start;
+        airtimeMs[index] = 0.0f;
+    }
+    airtimeMs[index] += float(ms);
+}
+
+double airtime_accounting::Window::sum(qint64 windowMs, qint64 nowMs) const {
+    // Slots are counted whole, so the window is rounded up to full minutes
+    int slots = qBound(1, int((windowMs + SLOT_MS - 1) / SLOT_MS), SLOTS);
+    qint64 oldest = nowMs - nowMs % SLOT_MS - (slots - 1) * SLOT_MS;
+    double total = 0.0;
+    for (int i = 0; i < SLOTS; ++i) {
+        if (startMs[i] >= oldest && startMs[i] <= nowMs) {
+            total += airtimeMs[i];
+        }
+    }
+    return total;
+}
+
+quint32 airtime_accounting::transmitter(const mesh_event& event) const {
+    int away = event.hopsAway();
+    if (away == 0) {
+        return event.from;
+    }
+    if (event.relayNode < 0) {
+        return 0;
+    }
+    const QVector<quint32> candidates = directByLowByte.value(event.relayNode);
+    return candidates.size() == 1 ? candidates.first() : 0;
+}
+
+double airtime_accounting::add(const mesh_event& event) {
+    if (event.from == 0) {
+        return 0.0;
+    }
+
+    // Telemetry events carry the node's own view, the packet itself is accounted separately
+    if (event.kind == mesh_event::Telemetry) {
+        Node& node = nodes[event.from];
+        if (!std::isnan(event.airUtilTx)) {
+            node.reportedTx = event.airUtilTx;
+        }
+        if (!std::isnan(event.channelUtilization)) {
+            node.reportedChannel = event.channelUtilization;
+        }
+        return 0.0;
+    }
+    if (event.kind != mesh_event::Packet && event.kind != mesh_event::Text) {
+        return 0.0;
+    }
+
+    double ms = calculator.airtimeMs(event);
+    channel.add(ms, event.timestampMs);
+    ports[event.portnum].add(ms, event.timestampMs);
+
+    if (event.hopsAway() == 0) {
+        Node& sender = nodes[event.from];
+        if (!sender.heardDirect) {
+            sender.heardDirect = true;
+            directByLowByte[int(event.from & 0xff)].append(event.from);
+        }
+    }
+    quint32 sentBy = transmitter(event);
+    if (sentBy != 0) {
+        nodes[sentBy].tx.add(ms, event.timestampMs);
+    }
+    return ms;
+}
+
+double airtime_accounting::nodeAirtimeMs(quint32 node, qint64 windowMs, qint64 nowMs) const {
+    auto it = nodes.constFind(node);
+    return it == nodes.constEnd() ? 0.0 : it->tx.sum(windowMs, nowMs);
+}
+
+double airtime_accounting::portAirtimeMs(int portnum, qint64 windowMs, qint64 nowMs) const {
+    auto it = ports.constFind(portnum);
+    return it == ports.constEnd() ? 0.0 : it->sum(windowMs, nowMs);
+}
+
+QVector<QPair<int, double>> airtime_accounting::portBreakdown(qint64 windowMs, qint64 nowMs) const {
+    QVector<QPair<int, double>> result;
+    for (auto it = ports.constBegin(); it != ports.constEnd(); ++it) {
+        double ms = it->sum(windowMs, nowMs);
+        if (ms > 0.0) {
+            result.append(qMakePair(it.key(), ms));
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const QPair<int, double>& a, const QPair<int, double>& b) {
+        return a.second > b.second;
+    });
+    return result;
+}
+
+airtime_check airtime_accounting::check(quint32 node, qint64 nowMs) const {
+    airtime_check result;
+    auto it = nodes.constFind(node);
+    if (it == nodes.constEnd()) {
+        return result;
+    }
+    result.reportedTxPercent = it->reportedTx;
+    result.reportedChannelPercent = it->reportedChannel;
+    // Only nodes we hear directly can be estimated, anything else we hear only in part
+    // The current slot is only partly over, so divide by the time the summed slots really cover
+    qint64 partial = nowMs % SLOT_MS;
+    if (it->heardDirect) {
+        result.estimatedTxPercent = 100.0 * it->tx.sum(HOUR_MS, nowMs) / (HOUR_MS - SLOT_MS + partial);
+    }
+    result.estimatedChannelPercent = 100.0 * channel.sum(2 * SLOT_MS, nowMs) / (SLOT_MS + partial);
+    return result;
+}
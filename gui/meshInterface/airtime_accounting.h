@@ -0,0 +1,76 @@
+#ifndef AIRTIME_ACCOUNTING_H
+#define AIRTIME_ACCOUNTING_H
+
+#include <QHash>
+#include <QVector>
+#include <QPair>
+#include <array>
+#include "mesh_event.h"
+#include "lora_airtime.h"
+
+// Our airtime estimate for a node next to what it reports about itself.
+// air_util_tx is the node's own transmit share of the last hour and
+// channel_utilization how busy it heard the channel over the last minute.
+struct airtime_check
+{
+    double estimatedTxPercent = NAN;
+    double reportedTxPercent = NAN;
+    double estimatedChannelPercent = NAN;
+    double reportedChannelPercent = NAN;
+};
+
+// Rolling airtime per transmitting node, per portnum and for the whole channel,
+// each a ring of SLOTS one-minute slots so the last hour is a sum of 60 floats.
+// Every copy heard is a transmission, so this should see the raw event stream,
+// duplicates included. A copy is charged to the node that actually sent it: the
+// originator for zero-hop packets, the relay (resolved from its low byte against
+// nodes heard directly) otherwise. Copies whose relay can't be resolved still
+// count towards the channel and port totals.
+class airtime_accounting
+{
+public:
+    static const int SLOTS = 60;
+    static const qint64 SLOT_MS = 60 * 1000;
+    static const qint64 HOUR_MS = SLOTS * SLOT_MS;
+
+    void setParams(const lora_params& params) { calculator = lora_airtime(params); }
+    // Copies the shared table for presets instead of working one out again
+    void setConfig(const meshtastic::Config_LoRaConfig& config) { calculator = lora_airtime::forConfig(config); }
+    const lora_params& params() const { return calculator.params(); }
+
+    // Returns the airtime charged for the event, 0 for events that weren't a transmission
+    double add(const mesh_event& event);
+
+    double nodeAirtimeMs(quint32 node, qint64 windowMs, qint64 nowMs) const;
+    double portAirtimeMs(int portnum, qint64 windowMs, qint64 nowMs) const;
+    double channelAirtimeMs(qint64 windowMs, qint64 nowMs) const { return channel.sum(windowMs, nowMs); }
+    // Busiest ports first
+    QVector<QPair<int, double>> portBreakdown(qint64 windowMs, qint64 nowMs) const;
+    airtime_check check(quint32 node, qint64 nowMs) const;
+
+private:
+    struct Window {
+        std::array<qint64, SLOTS> startMs{};
+        std::array<float, SLOTS> airtimeMs{};
+
+        void add(double ms, qint64 timestampMs);
+        double sum(qint64 windowMs, qint64 nowMs) const;
+    };
+
+    struct Node {
+        Window tx;
+        float reportedTx = NAN;
+        float reportedChannel = NAN;
+        bool heardDirect = false;
+    };
+
+    lora_airtime calculator;
+    QHash<quint32, Node> nodes;
+    QHash<int, Window> ports;
+    Window channel;
+    QHash<int, QVector<quint32>> directByLowByte;
+
+    quint32 transmitter(const mesh_event& event) const;
+};
+
+#endif // AIRTIME_ACCOUNTING_H
@@ -0,0 +1,209 @@
+#include "battery_trend.h"
+#include <QtGlobal>
+
+bool battery_trend::Sums::fit(double& intercept, double& slope) const {
+    double denominator = count * sxx - sx * sx;
+    if (count < MIN_FIT || denominator <= 1e-9) {
+        return false;
+    }
+    slope = (count * sxy - sx * sy) / denominator;
+    intercept = (sy - slope * sx) / count;
+    return true;
+}
+
+void battery_trend::Node::reset() {
+    head = 0;
+    count = 0;
+    sinceRebuild = 0;
+    all = Sums();
+    recent = Sums();
+    lastRaw = NAN;
+    residualScale = MIN_RESIDUAL;
+    anomalous = false;
+}
+
+void battery_trend::Node::push(const Sample& sample) {
+    if (count == 0) {
+        originMs = sample.timestampMs;
+    }
+    ring[(head + count) % WINDOW] = sample;
+    count++;
+
+    double x = hours(sample.timestampMs);
+    all.add(x, sample.level);
+    recent.add(x, sample.level);
+    if (recent.count > RECENT) {
+        const Sample& old = at(count - 1 - RECENT);
+        recent.remove(hours(old.timestampMs), old.level);
+    }
+}
+
+void battery_trend::Node::popOldest() {
+    const Sample& sample = ring[head];
+    double x = hours(sample.timestampMs);
+    all.remove(x, sample.level);
+    if (recent.count == count) {
+        recent.remove(x, sample.level);
+    }
+    head = (head + 1) % WINDOW;
+    count--;
+}
+
+// Moves the origin to the oldest sample and sums the ring again, once per WINDOW samples
+void battery_trend::Node::rebuild() {
+    sinceRebuild = 0;
+    all = Sums();
+    recent = Sums();
+    if (count == 0) {
+        return;
+    }
+    originMs = ring[head].timestampMs;
+    for (int i = 0; i < count; ++i) {
+        const Sample& sample = at(i);
+        double x = hours(sample.timestampMs);
+        all.add(x, sample.level);
+        if (i >= count - RECENT) {
+            recent.add(x, sample.level);
+        }
+    }
+}
+
+bool battery_trend::Node::fit(const Sums& sums, int samples, double& intercept, double& slope) const {
+    if (samples < MIN_FIT || at(count - 1).timestampMs - at(count - samples).timestampMs < MIN_SPAN_MS) {
+        return false;
+    }
+    return sums.fit(intercept, slope);
+}
+
+battery_estimate battery_trend::Node::current(qint64 nowMs) const {
+    battery_estimate result;
+    result.samples = count;
+    result.externalPower = externalPower;
+    result.baselinePerHour = baseline;
+    result.anomalous = anomalous;
+
+    double intercept, slope;
+    if (externalPower || !fit(all, count, intercept, slope)) {
+        return result;
+    }
+    result.level = float(qBound(0.0, intercept + slope * hours(nowMs), 100.0));
+    result.drainPerHour = float(-slope);
+    // Flat or rising batteries have no meaningful time to empty
+    if (result.drainPerHour > 0.05f) {
+        result.hoursToEmpty = result.level / result.drainPerHour;
+    }
+    if (fit(recent, recent.count, intercept, slope)) {
+        result.recentDrainPerHour = float(-slope);
+    }
+    return result;
+}
+
+battery_estimate battery_trend::add(quint32 node, float level, qint64 timestampMs, bool externalPower) {
+    Node& n = nodes[node];
+
+    if (externalPower || level > 100.0f) {
+        if (!n.externalPower) {
+            n.reset();
+            n.externalPower = true;
+        }
+        n.lastMs = timestampMs;
+        return n.current(timestampMs);
+    }
+    if (level < 0.0f || (n.count > 0 && timestampMs < n.lastMs)) {
+        return n.current(n.lastMs);
+    }
+
+    // A rise is judged against the fit when there is one, so recovering from a bogus low report isn't a charge
+    double intercept, slope;
+    bool fitted = !n.externalPower && n.fit(n.all, n.count, intercept, slope);
+    double expected = fitted ? intercept + slope * n.hours(timestampMs) : n.lastRaw;
+    float riseLimit = fitted ? qMax(RISE_RESET, CLIP_K * n.residualScale) : RISE_RESET;
+    if (n.externalPower || (n.count > 0 && level > expected + riseLimit)) {
+        // Unplugged or charged in between, the old slope says nothing about this discharge
+        n.reset();
+        n.externalPower = false;
+        fitted = false;
+    }
+    if (n.count > 0 && level == n.lastRaw && timestampMs - n.lastMs < MIN_SPACING_MS) {
+        return n.current(timestampMs);
+    }
+    float elapsedHours = n.count > 0 ? float(n.hours(timestampMs) - n.hours(n.lastMs)) : 0.0f;
+
+    // Clip against the fit so far, Huber style, before the sample can pull it
+    float clipped = level;
+    if (fitted) {
+        float residual = float(level - expected);
+        float limit = CLIP_K * n.residualScale;
+        clipped = float(expected) + qBound(-limit, residual, limit);
+        n.residualScale += RESIDUAL_ALPHA * (qMin(std::fabs(residual), limit) - n.residualScale);
+        n.residualScale = qMax(n.residualScale, MIN_RESIDUAL);
+    }
+
+    while (n.count > 0 && n.ring[n.head].timestampMs < timestampMs - MAX_AGE_MS) {
+        n.popOldest();
+    }
+    if (n.count == WINDOW) {
+        n.popOldest();
+    }
+    n.push({timestampMs, clipped});
+    n.lastRaw = level;
+    n.lastMs = timestampMs;
+    if (++n.sinceRebuild >= WINDOW) {
+        n.rebuild();
+    }
+
+    // The baseline waits for a full recent window, the first short fits of a discharge are mostly quantization
+    battery_estimate result = n.current(timestampMs);
+    if (!result.hasSlope() || n.count < RECENT) {
+        return result;
+    }
+
+    // Judge the recent slope against this node's history before the new fit joins the baseline
+    float fast = std::isnan(result.recentDrainPerHour) ? result.drainPerHour : result.recentDrainPerHour;
+    float limit = qMax(ANOMALY_K * n.baselineDev, MIN_ANOMALY_PER_HOUR);
+    bool judged = n.baselineHours >= BASELINE_MIN_HOURS;
+    bool anomalous;
+    if (n.anomalous) {
+        // Half the threshold to clear, so a slope sitting on the edge doesn't keep alerting
+        anomalous = fast >= FAST_DRAIN_PER_HOUR / 2 || (judged && fast - n.baseline > limit / 2);
+    } else {
+        anomalous = fast >= FAST_DRAIN_PER_HOUR || (judged && fast - n.baseline > limit);
+    }
+
+    if (std::isnan(n.baseline)) {
+        n.baseline = qMax(0.0f, result.drainPerHour);
+    } else {
+        // Weighted by time rather than samples, so nodes reporting often don't adapt faster.
+        // Both moves are clamped, a sustained change shifts the baseline gradually instead of at once
+        float alpha = qMin(1.0f, elapsedHours / BASELINE_HOURS);
+        n.baseline = qMax(0.0f, n.baseline + alpha * qBound(-limit, result.drainPerHour - n.baseline, limit));
+        n.baselineDev += alpha * (qMin(std::fabs(fast - n.baseline), limit) - n.baselineDev);
+        n.baselineHours += elapsedHours;
+    }
+
+    result.alert = anomalous && !n.anomalous;
+    result.anomalous = anomalous;
+    result.baselinePerHour = n.baseline;
+    n.anomalous = anomalous;
+    return result;
+}
+
+battery_estimate battery_trend::estimate(quint32 node) const {
+    auto it = nodes.constFind(node);
+    if (it == nodes.constEnd()) {
+        return battery_estimate();
+    }
+    return it->current(it->lastMs);
+}
+
+void battery_trend::rekey(quint32 from, quint32 to) {
+    auto it = nodes.find(from);
+    if (it == nodes.end() || from == to) {
+        return;
+    }
+    // History already under the real number wins, it can only be newer
+    if (!nodes.contains(to)) {
+        nodes.insert(to, it.value());
+    }
+    nodes.remove(from);
+}
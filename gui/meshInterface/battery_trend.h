@@ -0,0 +1,114 @@
+#ifndef BATTERY_TREND_H
+#define BATTERY_TREND_H
+
+#include <QHash>
+#include <array>
+#include <cmath>
+
+// Where a node's battery is heading, from the fit over its current window
+struct battery_estimate
+{
+    int samples = 0;
+    bool externalPower = false;
+    float level = NAN;          // fitted level now, in percent
+    float drainPerHour = NAN;   // percent per hour, positive while discharging
+    float recentDrainPerHour = NAN; // same over just the last few samples
+    float hoursToEmpty = NAN;   // NAN while not draining or not enough samples yet
+    float baselinePerHour = NAN;
+    bool anomalous = false;
+    bool alert = false;         // set only on the report that made the slope anomalous
+
+    bool hasSlope() const { return !std::isnan(drainPerHour); }
+};
+
+// Per-node battery drain rate in constant time and memory per sample. Each node
+// keeps a ring of the last WINDOW level samples with the running sums of a least
+// squares line; adding a sample updates the sums and dropping the oldest
+// subtracts it, so the slope is always O(1). The same sums over just the last
+// RECENT samples give a quicker slope for spotting changes. To stay robust
+// against the odd bogus report, a sample further than CLIP_K residual scales
+// from the current fit is clipped to that bound before it goes in (the scale is
+// an EWMA of the absolute residuals). The sums are rebuilt from the ring once
+// per WINDOW samples to re-origin the time axis and shed rounding drift, still
+// O(1) amortized. A rise in level or external power starts a new window.
+//
+// Each node also keeps a baseline drain, a time-weighted EWMA of its full
+// window slope, and how far its recent slope usually strays from it. A recent
+// slope draining ANOMALY_K of those deviations faster than the baseline, or
+// faster than FAST_DRAIN_PER_HOUR outright, is anomalous and raises one alert
+// until it recovers.
+class battery_trend
+{
+public:
+    static const int WINDOW = 48;
+    static const int RECENT = 16;
+    static const int MIN_FIT = 6;
+    static const qint64 MIN_SPACING_MS = 5 * 60 * 1000;   // repeats of the same level closer than this are dropped
+    static const qint64 MAX_AGE_MS = 24 * 60 * 60 * 1000;
+    static const qint64 MIN_SPAN_MS = 30 * 60 * 1000;     // 1% steps need some time to show a slope
+    static constexpr float RISE_RESET = 3.0f;             // percent above the fit means it was charged
+    static constexpr float CLIP_K = 3.0f;
+    static constexpr float MIN_RESIDUAL = 1.0f;           // levels come in whole percent
+    static constexpr float RESIDUAL_ALPHA = 0.1f;
+    static constexpr float BASELINE_HOURS = 24.0f;        // time constant of the baseline EWMA
+    static constexpr float BASELINE_MIN_HOURS = 4.0f;     // baseline history needed before judging against it
+    static constexpr float ANOMALY_K = 4.0f;
+    static constexpr float MIN_ANOMALY_PER_HOUR = 1.0f;
+    static constexpr float FAST_DRAIN_PER_HOUR = 8.0f;
+
+    // Battery level 101 is how Meshtastic reports running from external power
+    battery_estimate add(quint32 node, float level, qint64 timestampMs, bool externalPower = false);
+    battery_estimate estimate(quint32 node) const;
+    bool contains(quint32 node) const { return nodes.contains(node); }
+    // Moves a node's history to a new key, for samples taken before the node number was known
+    void rekey(quint32 from, quint32 to);
+    void clear() { nodes.clear(); }
+
+private:
+    struct Sample {
+        qint64 timestampMs;
+        float level; // after clipping, so removal subtracts exactly what was added
+    };
+
+    // Least squares sums with x in hours since the node's origin
+    struct Sums {
+        int count = 0;
+        double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+
+        void add(double x, double y) { count++; sx += x; sy += y; sxx += x * x; sxy += x * y; }
+        void remove(double x, double y) { count--; sx -= x; sy -= y; sxx -= x * x; sxy -= x * y; }
+        bool fit(double& intercept, double& slope) const;
+    };
+
+    struct Node {
+        std::array<Sample, WINDOW> ring;
+        int head = 0;  // oldest sample
+        int count = 0;
+        int sinceRebuild = 0;
+        qint64 originMs = 0;
+        Sums all;
+        Sums recent;   // the newest min(count, RECENT) samples
+        float lastRaw = NAN;
+        qint64 lastMs = 0;
+        float residualScale = MIN_RESIDUAL;
+        bool externalPower = false;
+
+        float baseline = NAN;
+        float baselineDev = 0.0f;
+        float baselineHours = 0.0f;
+        bool anomalous = false;
+
+        const Sample& at(int i) const { return ring[(head + i) % WINDOW]; }
+        double hours(qint64 timestampMs) const { return (timestampMs - originMs) / (60.0 * 60.0 * 1000.0); }
+        void reset();
+        void push(const Sample& sample);
+        void popOldest();
+        void rebuild();
+        bool fit(const Sums& sums, int samples, double& intercept, double& slope) const;
+        battery_estimate current(qint64 nowMs) const;
+    };
+
+    QHash<quint32, Node> nodes;
+};
+
+#endif // BATTERY_TREND_H
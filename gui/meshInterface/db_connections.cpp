@@ -0,0 +1,83 @@
+#include "db_connections.h"
+#include <QSqlError>
+#include <QThread>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <memory>
+#include <unordered_map>
+
+namespace {
+// Shared by every connection: WAL lets readers run while a writer commits,
+// NORMAL sync is safe under WAL, and reads go through a 256 MB mapping
+const char* PRAGMAS[] = {
+    "PRAGMA journal_mode=WAL",
+    "PRAGMA synchronous=NORMAL",
+    "PRAGMA mmap_size=268435456",
+    "PRAGMA temp_store=MEMORY",
+    "PRAGMA busy_timeout=5000"
+};
+
+using statement_cache = std::unordered_map<QString, std::unique_ptr<QSqlQuery>>;
+
+// Connections never cross threads, so neither do their statement caches
+thread_local std::unordered_map<QString, statement_cache> statements;
+
+QString connectionName(const QString& name) {
+    return QString("%1@%2").arg(name).arg(reinterpret_cast<quintptr>(QThread::currentThread()), 0, 16);
+}
+}
+
+QSqlDatabase db_connections::open(const QString& name, const QString& path) {
+    QString connection = connectionName(name);
+    if (QSqlDatabase::contains(connection)) {
+        QSqlDatabase db = QSqlDatabase::database(connection);
+        if (db.isOpen()) {
+            return db;
+        }
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSqlDatabase db = QSqlDatabase::contains(connection) ? QSqlDatabase::database(connection, false)
+                                                         : QSqlDatabase::addDatabase("QSQLITE", connection);
+    db.setDatabaseName(path);
+    if (!db.open()) {
+        qDebug() << "Failed to open database" << path << ":" << db.lastError().text();
+        return db;
+    }
+
+    QSqlQuery pragma(db);
+    for (const char* statement : PRAGMAS) {
+        if (!pragma.exec(statement)) {
+            qDebug() << "Failed to apply" << statement << "to" << connection << ":" << pragma.lastError().text();
+        }
+    }
+    return db;
+}
+
+QSqlQuery* db_connections::prepared(const QSqlDatabase& db, const QString& sql) {
+    statement_cache& cache = statements[db.connectionName()];
+    auto it = cache.find(sql);
+    if (it != cache.end()) {
+        return it->second.get();
+    }
+
+    auto query = std::make_unique<QSqlQuery>(db);
+    // Cached statements are always read front to back, this avoids buffering rows for seeking
+    query->setForwardOnly(true);
+    if (!query->prepare(sql)) {
+        qDebug() << "Failed to prepare statement:" << query->lastError().text() << sql;
+        return nullptr;
+    }
+    return cache.emplace(sql, std::move(query)).first->second.get();
+}
+
+void db_connections::close(QSqlDatabase& db) {
+    QString connection = db.connectionName();
+    statements.erase(connection);
+    if (db.isOpen()) {
+        db.close();
+    }
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connection);
+}
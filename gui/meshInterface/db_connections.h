@@ -0,0 +1,28 @@
+#ifndef DB_CONNECTIONS_H
+#define DB_CONNECTIONS_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+
+// One SQLite connection per (database, thread). QSqlDatabase handles may only be
+// used on the thread that created them, so the connection name includes the
+// thread; asking again from the same thread returns the same open connection.
+// Every connection gets the same pragmas, and prepared() keeps a per-connection
+// cache of prepared statements keyed by their SQL text.
+namespace db_connections {
+
+// Opens (or returns the already open) connection for this thread. Check isOpen() on the result.
+QSqlDatabase open(const QString& name, const QString& path);
+
+// Prepared statement owned by the connection's cache, nullptr if it fails to prepare.
+// Bind and exec it directly; finish() it after reading so SQLite can release the read.
+QSqlQuery* prepared(const QSqlDatabase& db, const QString& sql);
+
+// Drops the statement cache and removes the connection. The caller's handle is reset
+// because removeDatabase() requires that no handle to the connection is still alive.
+void close(QSqlDatabase& db);
+
+}
+
+#endif // DB_CONNECTIONS_H
@@ -15,6 +15,7 @@ public:
 #define ENABLE_DEBUG_PACKET false
 #define ENABLE_DEBUG_CONNECTION true
 #define ENABLE_DEBUG_MESH false
+#define ENABLE_DEBUG_MAP false
 
 #if ENABLE_DEBUG_PRINT
 #define DEBUG_PRINT(msg) qDebug() << msg
@@ -46,6 +47,12 @@ public:
 #define DEBUG_MESH(msg) do {} while(0)
 #endif
 
+#if ENABLE_DEBUG_MAP
+#define DEBUG_MAP(msg) qDebug() << "[MAP]" << msg
+#else
+#define DEBUG_MAP(msg) do {} while(0)
+#endif
+
 #define ERROR_PRINT(msg) qDebug() << "[ERROR]" << msg
 #define WARNING_PRINT(msg) qDebug() << "[WARNING]" << msg
 
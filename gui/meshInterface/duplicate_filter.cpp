@@ -0,0 +1,64 @@
+#include "duplicate_filter.h"
+
+duplicate_filter::duplicate_filter(QObject *parent)
+    : QObject{parent}
+{
+}
+
+void duplicate_filter::rotate(qint64 nowMs) {
+    if (generationStartMs == 0) {
+        generationStartMs = nowMs;
+        return;
+    }
+    if (nowMs - generationStartMs < WINDOW_MS) {
+        return;
+    }
+    // After a long silence both generations are stale
+    if (nowMs - generationStartMs >= 2 * WINDOW_MS) {
+        previous.clear();
+    } else {
+        previous.swap(current);
+    }
+    current.clear();
+    generationStartMs = nowMs;
+}
+
+int duplicate_filter::timesHeard(quint32 from, quint32 packetId) const {
+    quint64 k = key(from, packetId);
+    return current.value(k, previous.value(k, 0));
+}
+
+void duplicate_filter::process(const mesh_event& event) {
+    // Positions and telemetry are parsed from separate lines without an id, they pass through untouched
+    if (event.packetId == 0 || event.from == 0) {
+        emit eventAccepted(event);
+        return;
+    }
+
+    rotate(event.timestampMs);
+    seen++;
+    quint64 k = key(event.from, event.packetId);
+
+    int heard;
+    auto it = current.find(k);
+    if (it != current.end()) {
+        heard = ++it.value();
+    } else {
+        // Carry a key still in the old generation forward so it lives as long as it keeps being heard
+        heard = previous.take(k) + 1;
+        current.insert(k, heard);
+    }
+
+    if (heard == 1) {
+        emit eventAccepted(event);
+        return;
+    }
+
+    duplicates++;
+    byRelay[event.relayNode]++;
+    byHops[event.hopsAway()]++;
+    emit duplicateSeen(event, heard);
+    if (!suppressing) {
+        emit eventAccepted(event);
+    }
+}
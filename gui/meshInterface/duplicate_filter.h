@@ -0,0 +1,54 @@
+#ifndef DUPLICATE_FILTER_H
+#define DUPLICATE_FILTER_H
+
+#include <QObject>
+#include <QHash>
+#include "mesh_event.h"
+
+// Recognises rebroadcasts of a packet already heard, keyed on (from, id).
+// Seen keys live in two hash generations that swap every WINDOW_MS, so lookups
+// stay O(1), memory is bounded by the traffic of two windows, and a key is
+// forgotten between one and two windows after it was last heard.
+// Every event is passed on through eventAccepted unless suppression is on and it
+// is a repeat; repeats are counted per relay byte and per hop count either way.
+class duplicate_filter : public QObject
+{
+    Q_OBJECT
+public:
+    static const qint64 WINDOW_MS = 10 * 60 * 1000;
+
+    explicit duplicate_filter(QObject *parent = nullptr);
+
+    bool suppress() const { return suppressing; }
+
+    quint64 seenCount() const { return seen; }
+    quint64 duplicateCount() const { return duplicates; }
+    // Keyed by relay byte (-1 when the firmware didn't report it) and by hops away
+    const QHash<int, quint64>& repeatsByRelay() const { return byRelay; }
+    const QHash<int, quint64>& repeatsByHops() const { return byHops; }
+    // How many times this packet has been heard, 0 if it isn't remembered
+    int timesHeard(quint32 from, quint32 packetId) const;
+
+public slots:
+    void process(const mesh_event& event);
+    void setSuppress(bool suppress) { suppressing = suppress; }
+
+signals:
+    void eventAccepted(const mesh_event& event);
+    void duplicateSeen(const mesh_event& event, int timesHeard);
+
+private:
+    QHash<quint64, int> current;
+    QHash<quint64, int> previous;
+    qint64 generationStartMs = 0;
+    bool suppressing = false;
+    quint64 seen = 0;
+    quint64 duplicates = 0;
+    QHash<int, quint64> byRelay;
+    QHash<int, quint64> byHops;
+
+    static quint64 key(quint32 from, quint32 packetId) { return (quint64(from) << 32) | packetId; }
+    void rotate(qint64 nowMs);
+};
+
+#endif // DUPLICATE_FILTER_H
@@ -0,0 +1,174 @@
+#include "event_exporter.h"
+#include <QSaveFile>
+
+namespace {
+const char* CSV_HEADER = "timestamp_ms,kind,from,to,id,portnum,channel,rx_snr,rx_rssi,hop_limit,hop_start,"
+                         "battery_level,voltage,air_util_tx,channel_utilization,latitude,longitude,altitude,text\n";
+
+const char* kindName(mesh_event::Kind kind) {
+    switch (kind) {
+    case mesh_event::Packet: return "packet";
+    case mesh_event::Text: return "text";
+    case mesh_event::Position: return "position";
+    case mesh_event::Telemetry: return "telemetry";
+    default: return "info";
+    }
+}
+
+QByteArray optionalNumber(double value, int precision) {
+    return std::isnan(value) ? QByteArray() : QByteArray::number(value, 'f', precision);
+}
+
+QByteArray csvQuote(const QString& text) {
+    QByteArray quoted = text.toUtf8();
+    quoted.replace('"', "\"\"");
+    return '"' + quoted + '"';
+}
+}
+
+event_exporter::event_exporter(const event_store* store, const QString& fileName, Format format, QObject *parent)
+    : QObject{parent}
+    , store(store)
+    , fileName(fileName)
+    , format(format)
+    , cancelled(false)
+{
+}
+
+event_exporter::event_exporter(std::unique_ptr<packet_query> query, const QString& fileName, Format format, QObject *parent)
+    : QObject{parent}
+    , store(nullptr)
+    , query(std::move(query))
+    , fileName(fileName)
+    , format(format)
+    , cancelled(false)
+{
+}
+
+event_exporter::Format event_exporter::formatForFilter(const QString& nameFilter) {
+    if (nameFilter.contains("ndjson", Qt::CaseInsensitive)) {
+        return Ndjson;
+    }
+    if (nameFilter.contains("csv", Qt::CaseInsensitive)) {
+        return Csv;
+    }
+    return EventLines;
+}
+
+void event_exporter::cancel() {
+    cancelled = true;
+}
+
+void event_exporter::appendNdjson(QByteArray& out, const mesh_event& event) {
+    // The stored JSON is already compact, it is embedded as-is instead of being re-parsed
+    out += "{\"timestampMs\":" + QByteArray::number(event.timestampMs);
+    out += ",\"kind\":\"" + QByteArray(kindName(event.kind)) + '"';
+    out += ",\"level\":\"" + event.level.toUtf8() + '"';
+    out += ",\"data\":" + (event.json.isEmpty() ? QByteArray("null") : event.json);
+    out += "}\n";
+}
+
+void event_exporter::appendCsv(QByteArray& out, const mesh_event& event) {
+    out += QByteArray::number(event.timestampMs) + ',';
+    out += QByteArray(kindName(event.kind)) + ',';
+    out += (event.from ? event.fromId().toUtf8() : QByteArray()) + ',';
+    out += (event.to ? QString("!%1").arg(event.to, 8, 16, QChar('0')).toUtf8() : QByteArray()) + ',';
+    out += (event.packetId ? QByteArray::number(event.packetId) : QByteArray()) + ',';
+    out += (event.portnum >= 0 ? QByteArray::number(event.portnum) : QByteArray()) + ',';
+    out += (event.channel >= 0 ? QByteArray::number(event.channel) : QByteArray()) + ',';
+    out += optionalNumber(event.rxSnr, 2) + ',';
+    out += (event.rxRssi ? QByteArray::number(event.rxRssi) : QByteArray()) + ',';
+    out += (event.hopLimit >= 0 ? QByteArray::number(event.hopLimit) : QByteArray()) + ',';
+    out += (event.hopStart >= 0 ? QByteArray::number(event.hopStart) : QByteArray()) + ',';
+    out += (event.batteryLevel >= 0 ? QByteArray::number(event.batteryLevel) : QByteArray()) + ',';
+    out += optionalNumber(event.voltage, 3) + ',';
+    out += optionalNumber(event.airUtilTx, 3) + ',';
+    out += optionalNumber(event.channelUtilization, 3) + ',';
+    out += optionalNumber(event.latitude, 7) + ',';
+    out += optionalNumber(event.longitude, 7) + ',';
+    out += (event.hasPosition() ? QByteArray::number(event.altitude) : QByteArray()) + ',';
+    out += (event.text.isEmpty() ? QByteArray() : csvQuote(event.text)) + '\n';
+}
+
+// One "[level] json" line per stored event, the layout of the filter view.
+// These are the decoded events, not the firmware's text lines
+void event_exporter::appendEventLines(QByteArray& out, const mesh_event& event) {
+    out += '[' + event.level.toUtf8() + "] " + event.json + '\n';
+}
+
+void event_exporter::run() {
+    exportAll();
+    // The export thread's connection goes away with the thread
+    if (query) {
+        query->close();
+    }
+}
+
+void event_exporter::exportAll() {
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        emit finished(false, file.errorString(), 0);
+        return;
+    }
+
+    // Events that arrive while exporting are left for the next export
+    qint64 total = query ? query->count() : store->size();
+    QByteArray out;
+    if (format == Csv) {
+        out = CSV_HEADER;
+    }
+
+    int lastPercent = -1;
+    qint64 next = 0;
+    QVector<mesh_event> batch;
+    while (query || next < total) {
+        if (cancelled) {
+            file.cancelWriting();
+            file.commit();
+            emit finished(false, tr("Export cancelled"), next);
+            return;
+        }
+
+        if (query) {
+            if (!query->next(batch, BATCH_SIZE)) {
+                break;
+            }
+        } else {
+            batch = store->range(static_cast<quint32>(next), static_cast<int>(qMin<qint64>(BATCH_SIZE, total - next)));
+            if (batch.isEmpty()) {
+                break;
+            }
+        }
+        for (const mesh_event& event : batch) {
+            switch (format) {
+            case Ndjson: appendNdjson(out, event); break;
+            case Csv: appendCsv(out, event); break;
+            case EventLines: appendEventLines(out, event); break;
+            }
+        }
+        next += batch.size();
+
+        if (file.write(out) != out.size()) {
+            file.cancelWriting();
+            file.commit();
+            emit finished(false, file.errorString(), next);
+            return;
+        }
+        out.clear();
+
+        int percent = total > 0 ? static_cast<int>(100.0 * qMin(next, total) / total) : 0;
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            emit progress(percent);
+        }
+    }
+
+    if (!out.isEmpty()) {
+        file.write(out);
+    }
+    if (!file.commit()) {
+        emit finished(false, file.errorString(), next);
+        return;
+    }
+    emit finished(true, QString(), next);
+}
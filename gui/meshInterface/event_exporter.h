@@ -0,0 +1,55 @@
+#ifndef EVENT_EXPORTER_H
+#define EVENT_EXPORTER_H
+
+#include <QObject>
+#include <QString>
+#include <atomic>
+#include <memory>
+#include "event_store.h"
+#include "packet_query.h"
+
+// Streams the event store to a file on a worker thread. Events are copied out
+// in small batches so memory use doesn't depend on how big the log is, and the
+// file only replaces the target once everything has been written. The source is
+// either the in-memory event store or a packet_query over the SQLite history,
+// which is paged through on the export thread.
+class event_exporter : public QObject
+{
+    Q_OBJECT
+public:
+    enum Format {
+        Ndjson,
+        Csv,
+        EventLines
+    };
+    Q_ENUM(Format)
+
+    event_exporter(const event_store* store, const QString& fileName, Format format, QObject *parent = nullptr);
+    event_exporter(std::unique_ptr<packet_query> query, const QString& fileName, Format format, QObject *parent = nullptr);
+
+    static Format formatForFilter(const QString& nameFilter);
+    void cancel();
+
+public slots:
+    void run();
+
+signals:
+    void progress(int percent);
+    void finished(bool ok, const QString& error, qint64 exported);
+
+private:
+    static const int BATCH_SIZE = 4096;
+
+    const event_store* store;
+    std::unique_ptr<packet_query> query;
+    QString fileName;
+    Format format;
+    std::atomic<bool> cancelled;
+
+    void exportAll();
+    static void appendNdjson(QByteArray& out, const mesh_event& event);
+    static void appendCsv(QByteArray& out, const mesh_event& event);
+    static void appendEventLines(QByteArray& out, const mesh_event& event);
+};
+
+#endif // EVENT_EXPORTER_H
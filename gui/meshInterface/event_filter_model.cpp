@@ -0,0 +1,74 @@
+#include "event_filter_model.h"
+#include <QDateTime>
+
+event_filter_model::event_filter_model(event_store* store, QObject *parent)
+    : QAbstractListModel{parent}
+    , store(store)
+    , scanned(0)
+{
+    connect(store, &event_store::eventsAppended, this, &event_filter_model::onEventsAppended);
+    connect(store, &event_store::cleared, this, &event_filter_model::onCleared);
+}
+
+void event_filter_model::setFilter(const event_filter& newFilter) {
+    beginResetModel();
+    filter = newFilter;
+    if (filter.isEmpty()) {
+        rows.clear();
+        scanned = static_cast<quint32>(store->size());
+    } else {
+        // The replay appends from its own thread, so the size has to come from the same lock as the rows
+        rows = store->query(filter, 0, &scanned);
+    }
+    endResetModel();
+}
+
+int event_filter_model::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : rows.size();
+}
+
+QVariant event_filter_model::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= rows.size()) {
+        return QVariant();
+    }
+
+    if (role == Qt::DisplayRole) {
+        mesh_event event = store->at(rows[index.row()]);
+        // Same layout as the live packet log
+        return QString("[%1] %2").arg(event.level, QString::fromUtf8(event.json));
+    }
+    if (role == Qt::ToolTipRole) {
+        mesh_event event = store->at(rows[index.row()]);
+        return QDateTime::fromMSecsSinceEpoch(event.timestampMs).toString("yyyy-MM-dd hh:mm:ss");
+    }
+    return QVariant();
+}
+
+void event_filter_model::onEventsAppended(quint32 first, quint32 last) {
+    Q_UNUSED(first);
+    if (last < scanned) {
+        return;
+    }
+    // Nothing is shown without a filter, don't mirror the whole store
+    if (filter.isEmpty()) {
+        scanned = last + 1;
+        return;
+    }
+
+    // Signals from the replay thread arrive queued, the store may already be past last
+    QVector<quint32> added = store->query(filter, scanned, &scanned);
+    if (added.isEmpty()) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), rows.size(), rows.size() + added.size() - 1);
+    rows += added;
+    endInsertRows();
+}
+
+void event_filter_model::onCleared() {
+    beginResetModel();
+    rows.clear();
+    scanned = 0;
+    endResetModel();
+}
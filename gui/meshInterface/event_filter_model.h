@@ -0,0 +1,34 @@
+#ifndef EVENT_FILTER_MODEL_H
+#define EVENT_FILTER_MODEL_H
+
+#include <QAbstractListModel>
+#include "event_store.h"
+
+// List model of the events matching the filter bar. Only row indexes into the
+// store are kept here, new matches are appended as packets arrive instead of
+// re-running the whole query.
+class event_filter_model : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit event_filter_model(event_store* store, QObject *parent = nullptr);
+
+    void setFilter(const event_filter& filter);
+    const event_filter& currentFilter() const { return filter; }
+    quint32 eventIndex(int row) const { return rows.value(row); }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private slots:
+    void onEventsAppended(quint32 first, quint32 last);
+    void onCleared();
+
+private:
+    event_store* store;
+    event_filter filter;
+    QVector<quint32> rows;
+    quint32 scanned;
+};
+
+#endif // EVENT_FILTER_MODEL_H
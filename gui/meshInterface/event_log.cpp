@@ -0,0 +1,418 @@
+#include "event_log.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+// Fixed part of a record, stored in host byte order (the log never leaves the machine).
+// Any change here needs a new FORMAT_VERSION, the version is part of the segment names
+#pragma pack(push, 1)
+struct record_fixed
+{
+    qint64 timestampMs;
+    quint8 kind;
+    quint32 from;
+    quint32 to;
+    quint32 packetId;
+    qint32 portnum;
+    qint16 channel;
+    float rxSnr;
+    qint16 rxRssi;
+    qint8 hopLimit;
+    qint8 hopStart;
+    qint8 batteryLevel;
+    float voltage;
+    float airUtilTx;
+    float channelUtilization;
+    double latitude;
+    double longitude;
+    qint32 altitude;
+    qint16 relayNode;
+    qint32 payloadLength;
+    float distanceKm;
+    float bearingDeg;
+    quint16 levelLength;
+    quint32 textLength;
+    quint32 jsonLength;
+};
+#pragma pack(pop)
+
+const quint32 LENGTH_BYTES = sizeof(quint32);
+}
+
+event_log::~event_log() {
+    close();
+}
+
+QString event_log::segmentPath(int number, const char* suffix) const {
+    return QDir(directory).filePath(QString("segment-%1.v%2.%3").arg(number, 8, 10, QChar('0')).arg(FORMAT_VERSION).arg(suffix));
+}
+
+bool event_log::open(const QString& dir) {
+    close();
+    directory = dir;
+    QDir().mkpath(directory);
+
+    // Older record layouts can't be replayed, and the log only keeps days anyway
+    QDir logDir(directory);
+    QString current = QString(".v%1.").arg(FORMAT_VERSION);
+    for (const QString& name : logDir.entryList({"segment-*.bin", "segment-*.idx"}, QDir::Files)) {
+        if (!name.contains(current)) {
+            qDebug() << "Event log: removing" << name << "from an older record format";
+            logDir.remove(name);
+        }
+    }
+
+    QStringList names = logDir.entryList({QString("segment-*.v%1.bin").arg(FORMAT_VERSION)}, QDir::Files, QDir::Name);
+    for (const QString& name : names) {
+        int number = name.mid(8, 8).toInt();
+        // The newest segment is still being written, it never has a saved index
+        if (name == names.last()) {
+            // One that can't be scanned is left alone and writing moves on to a fresh one
+            if (!openActive(number, false) && !openActive(number + 1, true)) {
+                close();
+                return false;
+            }
+            continue;
+        }
+        // A closed segment that can't be read is skipped rather than costing the whole log
+        Segment s;
+        s.number = number;
+        segments.push_back(s);
+        int segment = int(segments.size()) - 1;
+        if (!loadIndex(segment) && !scanSegment(segment)) {
+            segments.pop_back();
+        }
+    }
+
+    if (segments.empty() && !openActive(0, true)) {
+        return false;
+    }
+    prune();
+    qDebug() << "Event log opened:" << records << "records in" << segments.size() << "segments";
+    return true;
+}
+
+void event_log::close() {
+    active.close();
+    segments.clear();
+    index.clear();
+    maxTimestamp = std::numeric_limits<qint64>::min();
+    records = 0;
+}
+
+bool event_log::openActive(int number, bool create) {
+    active.close();
+    active.setFileName(segmentPath(number, "bin"));
+    // Unbuffered, so a read() mapping the file sees every record as soon as append() returns
+    if (!active.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        qDebug() << "Event log: could not open" << active.fileName() << active.errorString();
+        return false;
+    }
+    // Segments are fixed size; the unused tail reads as zero, which ends the record walk
+    if (create || active.size() < SEGMENT_BYTES) {
+        active.resize(SEGMENT_BYTES);
+    }
+    Segment s;
+    s.number = number;
+    segments.push_back(s);
+    if (!create && !scanSegment(int(segments.size()) - 1)) {
+        segments.pop_back();
+        active.close();
+        return false;
+    }
+    return true;
+}
+
+// Only mapped while it is walked, a long history doesn't hold address space
+// (a 32-bit Pi runs out after a few dozen 16 MB mappings)
+const uchar* event_log::mapSegment(QFile& file, int number, qint64& bytes) const {
+    file.setFileName(segmentPath(number, "bin"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Event log: could not open" << file.fileName() << file.errorString();
+        return nullptr;
+    }
+    bytes = qMin(bytes, file.size());
+    const uchar* data = bytes > 0 ? file.map(0, bytes) : nullptr;
+    if (!data) {
+        qDebug() << "Event log: could not map" << file.fileName() << file.errorString();
+    }
+    return data;
+}
+
+// Age and count limits; the segment being written is never removed
+void event_log::prune() {
+    qint64 cutoff = QDateTime::currentMSecsSinceEpoch() - maxAgeSecs * 1000;
+    int closed = int(segments.size()) - 1;
+    int drop = 0;
+    while (drop < closed && (int(segments.size()) - drop > maxSegments || segments[drop].maxTimestamp < cutoff)) {
+        QDir(directory).remove(segmentPath(segments[drop].number, "bin"));
+        QDir(directory).remove(segmentPath(segments[drop].number, "idx"));
+        records -= segments[drop].recordsInSegment;
+        drop++;
+    }
+    if (drop == 0) {
+        return;
+    }
+    segments.erase(segments.begin(), segments.begin() + drop);
+    QVector<IndexEntry> kept;
+    kept.reserve(index.size());
+    for (IndexEntry entry : index) {
+        if (entry.segment >= drop) {
+            entry.segment -= drop;
+            kept.append(entry);
+        }
+    }
+    index = kept;
+}
+
+void event_log::addRecord(int segment, quint32 offset, qint64 timestampMs) {
+    Segment& s = segments[segment];
+    if (s.recordsInSegment % INDEX_STRIDE == 0) {
+        index.append({maxTimestamp, segment, offset});
+    }
+    s.recordsInSegment++;
+    s.maxTimestamp = qMax(s.maxTimestamp, timestampMs);
+    records++;
+    maxTimestamp = qMax(maxTimestamp, timestampMs);
+}
+
+bool event_log::scanSegment(int segment) {
+    Segment& s = segments[segment];
+    QFile file;
+    qint64 size = SEGMENT_BYTES;
+    const uchar* data = mapSegment(file, s.number, size);
+    if (!data) {
+        return false;
+    }
+    quint32 offset = 0;
+    while (offset + LENGTH_BYTES <= size) {
+        quint32 length;
+        std::memcpy(&length, data + offset, LENGTH_BYTES);
+        // A zero length is the untouched tail, anything that doesn't fit is a torn write
+        if (length < sizeof(record_fixed) || qint64(offset) + LENGTH_BYTES + length > size) {
+            break;
+        }
+        qint64 timestampMs;
+        std::memcpy(&timestampMs, data + offset + LENGTH_BYTES, sizeof(timestampMs));
+        addRecord(segment, offset, timestampMs);
+        offset += LENGTH_BYTES + length;
+    }
+    s.used = offset;
+    file.unmap(const_cast<uchar*>(data));
+    return true;
+}
+
+bool event_log::loadIndex(int segment) {
+    QFile file(segmentPath(segments[segment].number, "idx"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // Header: used bytes, record count, max timestamp; then (maxTimestampBefore, offset) pairs
+    qint64 header[3];
+    if (file.read(reinterpret_cast<char*>(header), sizeof(header)) != sizeof(header)
+            || header[0] < 0 || header[0] > SEGMENT_BYTES) {
+        return false;
+    }
+    QByteArray body = file.readAll();
+    int entries = body.size() / int(sizeof(qint64) + sizeof(quint32));
+    const char* p = body.constData();
+    for (int i = 0; i < entries; ++i) {
+        IndexEntry entry;
+        std::memcpy(&entry.maxTimestampBefore, p, sizeof(qint64));
+        std::memcpy(&entry.offset, p + sizeof(qint64), sizeof(quint32));
+        entry.segment = segment;
+        index.append(entry);
+        p += sizeof(qint64) + sizeof(quint32);
+    }
+
+    Segment& s = segments[segment];
+    s.used = header[0];
+    s.recordsInSegment = int(header[1]);
+    s.maxTimestamp = header[2];
+    records += header[1];
+    maxTimestamp = qMax(maxTimestamp, header[2]);
+    return true;
+}
+
+void event_log::saveIndex(int segment) const {
+    const Segment& s = segments[segment];
+    QFile file(segmentPath(s.number, "idx"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+    qint64 header[3] = {s.used, s.recordsInSegment, s.maxTimestamp};
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const IndexEntry& entry : index) {
+        if (entry.segment == segment) {
+            file.write(reinterpret_cast<const char*>(&entry.maxTimestampBefore), sizeof(qint64));
+            file.write(reinterpret_cast<const char*>(&entry.offset), sizeof(quint32));
+        }
+    }
+}
+
+void event_log::encode(const mesh_event& event, QByteArray& out) {
+    QByteArray level = event.level.toUtf8();
+    QByteArray text = event.text.toUtf8();
+
+    record_fixed fixed;
+    fixed.timestampMs = event.timestampMs;
+    fixed.kind = quint8(event.kind);
+    fixed.from = event.from;
+    fixed.to = event.to;
+    fixed.packetId = event.packetId;
+    fixed.portnum = event.portnum;
+    fixed.channel = qint16(event.channel);
+    fixed.rxSnr = event.rxSnr;
+    fixed.rxRssi = qint16(event.rxRssi);
+    fixed.hopLimit = qint8(event.hopLimit);
+    fixed.hopStart = qint8(event.hopStart);
+    fixed.batteryLevel = qint8(qMin(event.batteryLevel, 127));
+    fixed.voltage = event.voltage;
+    fixed.airUtilTx = event.airUtilTx;
+    fixed.channelUtilization = event.channelUtilization;
+    fixed.latitude = event.latitude;
+    fixed.longitude = event.longitude;
+    fixed.altitude = event.altitude;
+    fixed.relayNode = qint16(event.relayNode);
+    fixed.payloadLength = event.payloadLength;
+    fixed.distanceKm = event.distanceKm;
+    fixed.bearingDeg = event.bearingDeg;
+    fixed.levelLength = quint16(qMin<qsizetype>(level.size(), 0xffff));
+    fixed.textLength = quint32(text.size());
+    fixed.jsonLength = quint32(event.json.size());
+
+    quint32 length = quint32(sizeof(fixed) + fixed.levelLength + text.size() + event.json.size());
+    out.clear();
+    out.reserve(LENGTH_BYTES + length);
+    out.append(reinterpret_cast<const char*>(&length), LENGTH_BYTES);
+    out.append(reinterpret_cast<const char*>(&fixed), sizeof(fixed));
+    out.append(level.constData(), fixed.levelLength);
+    out.append(text);
+    out.append(event.json);
+}
+
+bool event_log::decode(const uchar* data, quint32 length, mesh_event& event) {
+    record_fixed fixed;
+    if (length < sizeof(fixed)) {
+        return false;
+    }
+    std::memcpy(&fixed, data, sizeof(fixed));
+    if (quint64(sizeof(fixed)) + fixed.levelLength + fixed.textLength + fixed.jsonLength > length) {
+        return false;
+    }
+
+    event.timestampMs = fixed.timestampMs;
+    event.kind = mesh_event::Kind(fixed.kind);
+    event.from = fixed.from;
+    event.to = fixed.to;
+    event.packetId = fixed.packetId;
+    event.portnum = fixed.portnum;
+    event.channel = fixed.channel;
+    event.rxSnr = fixed.rxSnr;
+    event.rxRssi = fixed.rxRssi;
+    event.hopLimit = fixed.hopLimit;
+    event.hopStart = fixed.hopStart;
+    event.batteryLevel = fixed.batteryLevel;
+    event.voltage = fixed.voltage;
+    event.airUtilTx = fixed.airUtilTx;
+    event.channelUtilization = fixed.channelUtilization;
+    event.latitude = fixed.latitude;
+    event.longitude = fixed.longitude;
+    event.altitude = fixed.altitude;
+    event.relayNode = fixed.relayNode;
+    event.payloadLength = fixed.payloadLength;
+    event.distanceKm = fixed.distanceKm;
+    event.bearingDeg = fixed.bearingDeg;
+
+    const char* p = reinterpret_cast<const char*>(data) + sizeof(fixed);
+    event.level = QString::fromUtf8(p, fixed.levelLength);
+    p += fixed.levelLength;
+    event.text = QString::fromUtf8(p, fixed.textLength);
+    p += fixed.textLength;
+    event.json = QByteArray(p, fixed.jsonLength);
+    return true;
+}
+
+bool event_log::append(const mesh_event& event) {
+    if (segments.empty()) {
+        return false;
+    }
+
+    encode(event, encoded);
+    if (encoded.size() > SEGMENT_BYTES) {
+        return false;
+    }
+
+    int segment = int(segments.size()) - 1;
+    if (segments[segment].used + encoded.size() > SEGMENT_BYTES) {
+        saveIndex(segment);
+        if (!openActive(segments[segment].number + 1, true)) {
+            return false;
+        }
+        prune();
+        segment = int(segments.size()) - 1;
+    }
+
+    Segment& s = segments[segment];
+    active.seek(s.used);
+    if (active.write(encoded) != encoded.size()) {
+        qDebug() << "Event log write failed:" << active.errorString();
+        return false;
+    }
+    addRecord(segment, quint32(s.used), event.timestampMs);
+    s.used += encoded.size();
+    return true;
+}
+
+int event_log::read(qint64 fromMs, qint64 toMs, const std::function<bool(const mesh_event&)>& visit) const {
+    if (index.isEmpty()) {
+        return 0;
+    }
+
+    // Last index entry whose preceding records are all older than fromMs
+    auto it = std::lower_bound(index.constBegin(), index.constEnd(), fromMs,
+                               [](const IndexEntry& entry, qint64 t) { return entry.maxTimestampBefore < t; });
+    if (it != index.constBegin()) {
+        --it;
+    }
+
+    int visited = 0;
+    mesh_event event;
+    quint32 offset = it->offset;
+    for (int segment = it->segment; segment < int(segments.size()); ++segment, offset = 0) {
+        QFile file;
+        qint64 used = segments[segment].used;
+        const uchar* data = used > 0 ? mapSegment(file, segments[segment].number, used) : nullptr;
+        if (!data) {
+            continue;
+        }
+        while (offset + LENGTH_BYTES <= used) {
+            quint32 length;
+            std::memcpy(&length, data + offset, LENGTH_BYTES);
+            // Same bounds as scanSegment, used can come from an .idx file that no longer matches the segment
+            if (length < sizeof(record_fixed) || qint64(offset) + LENGTH_BYTES + length > used) {
+                break;
+            }
+            qint64 timestampMs;
+            std::memcpy(&timestampMs, data + offset + LENGTH_BYTES, sizeof(timestampMs));
+            const uchar* record = data + offset + LENGTH_BYTES;
+            offset += LENGTH_BYTES + length;
+
+            if (timestampMs < fromMs) {
+                continue;
+            }
+            if (timestampMs > toMs || !decode(record, length, event)) {
+                return visited;
+            }
+            visited++;
+            if (!visit(event)) {
+                return visited;
+            }
+        }
+    }
+    return visited;
+}
@@ -0,0 +1,87 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "mesh_event.h"
+
+// Append-only binary log of every event, split into fixed-size segment files
+// that are memory-mapped while they are read. Each record is a u32 length followed
+// by the encoded event. A sparse index (one entry every INDEX_STRIDE records) maps
+// time to a segment offset, so seeking to a time is a binary search and reading
+// the last day is a sequential walk over mapped memory. Closed segments keep
+// their index in a .idx file next to them so startup doesn't rescan them, and are
+// deleted once they pass the age or count limit.
+class event_log
+{
+public:
+    static const qint64 SEGMENT_BYTES = 16 * 1024 * 1024;
+    static const int INDEX_STRIDE = 256;
+    // Part of every segment name, segments written with another layout are removed on open
+    static const int FORMAT_VERSION = 2;
+
+    event_log() = default;
+    ~event_log();
+    event_log(const event_log&) = delete;
+    event_log& operator=(const event_log&) = delete;
+
+    bool open(const QString& directory);
+    void close();
+    bool isOpen() const { return !segments.empty(); }
+
+    // Checked on open and whenever a segment fills up
+    void setMaxSegments(int count) { maxSegments = count; }
+    void setMaxAge(qint64 seconds) { maxAgeSecs = seconds; }
+
+    bool append(const mesh_event& event);
+
+    // Calls visit for records from fromMs on, in the order they were logged,
+    // until a record newer than toMs or visit returns false. Returns the count visited.
+    int read(qint64 fromMs, qint64 toMs, const std::function<bool(const mesh_event&)>& visit) const;
+
+    quint64 recordCount() const { return records; }
+
+private:
+    struct Segment {
+        int number = 0;
+        qint64 used = 0;
+        int recordsInSegment = 0;
+        qint64 maxTimestamp = std::numeric_limits<qint64>::min();
+    };
+
+    // Every record before (segment, offset) is older than maxTimestampBefore
+    struct IndexEntry {
+        qint64 maxTimestampBefore;
+        int segment;
+        quint32 offset;
+    };
+
+    QString directory;
+    std::vector<Segment> segments;
+    // The last segment, the only one kept open
+    QFile active;
+    QVector<IndexEntry> index;
+    qint64 maxTimestamp = std::numeric_limits<qint64>::min();
+    quint64 records = 0;
+    int maxSegments = 64;
+    qint64 maxAgeSecs = 7 * 24 * 60 * 60;
+    QByteArray encoded;
+
+    QString segmentPath(int number, const char* suffix) const;
+    bool openActive(int number, bool create);
+    const uchar* mapSegment(QFile& file, int number, qint64& bytes) const;
+    bool scanSegment(int segment);
+    void prune();
+    bool loadIndex(int segment);
+    void saveIndex(int segment) const;
+    void addRecord(int segment, quint32 offset, qint64 timestampMs);
+
+    static void encode(const mesh_event& event, QByteArray& out);
+    static bool decode(const uchar* data, quint32 length, mesh_event& event);
+};
+
+#endif // EVENT_LOG_H
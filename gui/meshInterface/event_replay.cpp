@@ -0,0 +1,45 @@
+#include "event_replay.h"
+#include <QElapsedTimer>
+
+event_replay::event_replay(event_log* log, const QString& directory, event_store* store, node_series* series,
+                           qint64 fromMs, qint64 toMs, QObject *parent)
+    : QObject(parent),
+      log(log),
+      directory(directory),
+      store(store),
+      series(series),
+      fromMs(fromMs),
+      toMs(toMs),
+      cancelled(false)
+{
+}
+
+void event_replay::cancel() {
+    cancelled = true;
+}
+
+void event_replay::run() {
+    QElapsedTimer timer;
+    timer.start();
+    if (!log->open(directory)) {
+        emit finished(false, 0, timer.elapsed());
+        return;
+    }
+
+    QVector<mesh_event> batch;
+    batch.reserve(BATCH_SIZE);
+    auto flush = [this, &batch]() {
+        store->appendBatch(batch);
+        series->appendBatch(batch);
+        batch.clear();
+    };
+    int replayed = log->read(fromMs, toMs, [this, &batch, &flush](const mesh_event& event) {
+        batch.append(event);
+        if (batch.size() >= BATCH_SIZE) {
+            flush();
+        }
+        return !cancelled;
+    });
+    flush();
+    emit finished(true, replayed, timer.elapsed());
+}
@@ -0,0 +1,42 @@
+#ifndef EVENT_REPLAY_H
+#define EVENT_REPLAY_H
+
+#include <QObject>
+#include <QString>
+#include <atomic>
+#include "event_log.h"
+#include "event_store.h"
+#include "node_series.h"
+
+// Opens the binary event log and replays [fromMs, toMs] into the event store and
+// node series on a worker thread, so a long history doesn't hold up startup.
+// Events are decoded into batches and each batch is loaded under one lock.
+// Nothing else may touch the log until finished() has been emitted.
+class event_replay : public QObject
+{
+    Q_OBJECT
+public:
+    event_replay(event_log* log, const QString& directory, event_store* store, node_series* series,
+                 qint64 fromMs, qint64 toMs, QObject *parent = nullptr);
+
+    void cancel();
+
+public slots:
+    void run();
+
+signals:
+    void finished(bool opened, int replayed, qint64 elapsedMs);
+
+private:
+    static const int BATCH_SIZE = 4096;
+
+    event_log* log;
+    QString directory;
+    event_store* store;
+    node_series* series;
+    qint64 fromMs;
+    qint64 toMs;
+    std::atomic<bool> cancelled;
+};
+
+#endif // EVENT_REPLAY_H
@@ -0,0 +1,277 @@
+#include "event_store.h"
+#include "meshtastic/portnums.pb.h"
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QStringList>
+#include <algorithm>
+
+bool event_filter::isEmpty() const {
+    return !hasNode && portnum < 0 && channel < 0 && !hasMinSnr && !hasMaxSnr && text.isEmpty();
+}
+
+bool event_filter::matches(const mesh_event& event) const {
+    if (hasNode && event.from != node) {
+        return false;
+    }
+    if (portnum >= 0 && event.portnum != portnum) {
+        return false;
+    }
+    if (channel >= 0 && event.channel != channel) {
+        return false;
+    }
+    if (hasMinSnr || hasMaxSnr) {
+        if (!event.hasSnr()) {
+            return false;
+        }
+        if (hasMinSnr && event.rxSnr < minSnr) {
+            return false;
+        }
+        if (hasMaxSnr && event.rxSnr > maxSnr) {
+            return false;
+        }
+    }
+    if (!text.isEmpty() && !event.text.contains(text, Qt::CaseInsensitive)) {
+        return false;
+    }
+    return true;
+}
+
+event_filter event_filter::parse(const QString& line, QString* error) {
+    event_filter filter;
+    QStringList words;
+
+    for (const QString& token : line.split(' ', Qt::SkipEmptyParts)) {
+        int colon = token.indexOf(':');
+        QString key = colon > 0 ? token.left(colon).toLower() : QString();
+        QString value = colon > 0 ? token.mid(colon + 1) : QString();
+        bool ok = true;
+
+        if (key == "node" || key == "from") {
+            QString hex = value;
+            if (hex.startsWith('!')) {
+                hex.remove(0, 1);
+            }
+            filter.node = hex.toUInt(&ok, 16);
+            filter.hasNode = ok;
+        } else if (key == "port" || key == "portnum") {
+            filter.portnum = value.toInt(&ok);
+            if (!ok) {
+                // Accept the protobuf name with or without the _APP suffix
+                meshtastic::PortNum port;
+                QString name = value.toUpper();
+                ok = meshtastic::PortNum_Parse(name.toStdString(), &port) ||
+                     meshtastic::PortNum_Parse((name + "_APP").toStdString(), &port);
+                filter.portnum = ok ? static_cast<int>(port) : -1;
+            }
+        } else if (key == "ch" || key == "channel") {
+            filter.channel = value.toInt(&ok, 0);
+            if (!ok) {
+                filter.channel = -1;
+            }
+        } else if (key == "snr") {
+            // snr:-5..10, snr:..0 or snr:5.. (a single number is a minimum)
+            int dots = value.indexOf("..");
+            QString low = dots >= 0 ? value.left(dots) : value;
+            QString high = dots >= 0 ? value.mid(dots + 2) : QString();
+            if (!low.isEmpty()) {
+                filter.minSnr = low.toFloat(&ok);
+                filter.hasMinSnr = ok;
+            }
+            if (ok && !high.isEmpty()) {
+                filter.maxSnr = high.toFloat(&ok);
+                filter.hasMaxSnr = ok;
+            }
+        } else {
+            words.append(token);
+            continue;
+        }
+
+        if (!ok && error) {
+            *error = QString("Could not understand \"%1\"").arg(token);
+        }
+    }
+
+    filter.text = words.join(' ');
+    return filter;
+}
+
+event_store::event_store(QObject *parent)
+    : QObject{parent}
+    , count(0)
+{
+}
+
+const mesh_event& event_store::eventAt(quint32 index) const {
+    return chunks[index / CHUNK_SIZE][index % CHUNK_SIZE];
+}
+
+// Three UTF-16 code units packed into one key
+quint64 event_store::trigram(const QString& text, int pos) {
+    return (static_cast<quint64>(text[pos].unicode()) << 32) |
+           (static_cast<quint64>(text[pos + 1].unicode()) << 16) |
+           static_cast<quint64>(text[pos + 2].unicode());
+}
+
+// Posting lists stay sorted because indexes only ever grow
+void event_store::post(QVector<quint32>& list, quint32 index) {
+    if (list.isEmpty() || list.last() != index) {
+        list.append(index);
+    }
+}
+
+quint32 event_store::append(const mesh_event& event) {
+    quint32 index;
+    {
+        QWriteLocker locker(&lock);
+        index = insert(event);
+    }
+    emit eventsAppended(index, index);
+    return index;
+}
+
+void event_store::appendBatch(const QVector<mesh_event>& events) {
+    if (events.isEmpty()) {
+        return;
+    }
+    quint32 first;
+    quint32 last = 0;
+    {
+        QWriteLocker locker(&lock);
+        first = count;
+        for (const mesh_event& event : events) {
+            last = insert(event);
+        }
+    }
+    emit eventsAppended(first, last);
+}
+
+quint32 event_store::insert(const mesh_event& event) {
+    if (chunks.isEmpty() || chunks.last().size() >= CHUNK_SIZE) {
+        chunks.append(QVector<mesh_event>());
+        chunks.last().reserve(CHUNK_SIZE);
+    }
+    chunks.last().append(event);
+    quint32 index = count++;
+
+    if (event.from != 0) {
+        post(byNode[event.from], index);
+    }
+    if (event.portnum >= 0) {
+        post(byPortnum[event.portnum], index);
+    }
+    if (event.channel >= 0) {
+        post(byChannel[event.channel], index);
+    }
+    if (!event.text.isEmpty()) {
+        textEvents.append(index);
+        QString lower = event.text.toLower();
+        for (int i = 0; i + MIN_TEXT_INDEX <= lower.size(); ++i) {
+            post(byTrigram[trigram(lower, i)], index);
+        }
+    }
+    return index;
+}
+
+int event_store::size() const {
+    QReadLocker locker(&lock);
+    return static_cast<int>(count);
+}
+
+mesh_event event_store::at(quint32 index) const {
+    QReadLocker locker(&lock);
+    if (index >= count) {
+        return mesh_event();
+    }
+    return eventAt(index);
+}
+
+QVector<mesh_event> event_store::range(quint32 first, int maxCount) const {
+    QReadLocker locker(&lock);
+    QVector<mesh_event> out;
+    if (first >= count || maxCount <= 0) {
+        return out;
+    }
+    quint32 last = qMin<quint32>(count, first + static_cast<quint32>(maxCount));
+    out.reserve(static_cast<int>(last - first));
+    for (quint32 i = first; i < last; ++i) {
+        out.append(eventAt(i));
+    }
+    return out;
+}
+
+void event_store::clear() {
+    {
+        QWriteLocker locker(&lock);
+        chunks.clear();
+        count = 0;
+        byNode.clear();
+        byPortnum.clear();
+        byChannel.clear();
+        byTrigram.clear();
+        textEvents.clear();
+    }
+    emit cleared();
+}
+
+QVector<quint32> event_store::query(const event_filter& filter, quint32 fromIndex, quint32* scannedTo) const {
+    QReadLocker locker(&lock);
+    if (scannedTo) {
+        *scannedTo = count;
+    }
+    QVector<quint32> out;
+    if (fromIndex >= count) {
+        return out;
+    }
+
+    // Every match has to be in each of these lists, so only the shortest one is walked
+    static const QVector<quint32> none;
+    const QVector<quint32>* candidates = nullptr;
+    auto consider = [&candidates](const QVector<quint32>* list) {
+        if (!candidates || list->size() < candidates->size()) {
+            candidates = list;
+        }
+    };
+
+    if (filter.hasNode) {
+        auto it = byNode.constFind(filter.node);
+        consider(it == byNode.constEnd() ? &none : &it.value());
+    }
+    if (filter.portnum >= 0) {
+        auto it = byPortnum.constFind(filter.portnum);
+        consider(it == byPortnum.constEnd() ? &none : &it.value());
+    }
+    if (filter.channel >= 0) {
+        auto it = byChannel.constFind(filter.channel);
+        consider(it == byChannel.constEnd() ? &none : &it.value());
+    }
+    if (!filter.text.isEmpty()) {
+        QString lower = filter.text.toLower();
+        if (lower.size() >= MIN_TEXT_INDEX) {
+            for (int i = 0; i + MIN_TEXT_INDEX <= lower.size(); ++i) {
+                auto it = byTrigram.constFind(trigram(lower, i));
+                consider(it == byTrigram.constEnd() ? &none : &it.value());
+            }
+        } else {
+            consider(&textEvents);
+        }
+    }
+
+    if (!candidates) {
+        // Nothing indexed to narrow it down (no filter or only an SNR range), walk the log
+        for (quint32 i = fromIndex; i < count; ++i) {
+            if (filter.matches(eventAt(i))) {
+                out.append(i);
+            }
+        }
+        return out;
+    }
+
+    // Candidates are verified against the full filter, which also confirms trigram hits
+    auto it = std::lower_bound(candidates->constBegin(), candidates->constEnd(), fromIndex);
+    for (; it != candidates->constEnd(); ++it) {
+        if (filter.matches(eventAt(*it))) {
+            out.append(*it);
+        }
+    }
+    return out;
+}
@@ -0,0 +1,78 @@
+#ifndef EVENT_STORE_H
+#define EVENT_STORE_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QReadWriteLock>
+#include "mesh_event.h"
+
+// What the filter bar asks for, any field left unset matches everything.
+// Parsed from a single line such as: node:!a1b2c3d4 port:TEXT_MESSAGE_APP ch:8 snr:-5..10 hello
+struct event_filter
+{
+    bool hasNode = false;
+    quint32 node = 0;
+    int portnum = -1;
+    int channel = -1;
+    bool hasMinSnr = false;
+    bool hasMaxSnr = false;
+    float minSnr = 0.0f;
+    float maxSnr = 0.0f;
+    QString text;
+
+    bool isEmpty() const;
+    bool matches(const mesh_event& event) const;
+    static event_filter parse(const QString& line, QString* error = nullptr);
+};
+
+// Append-only in-memory history of every mesh_event, stored in fixed-size chunks
+// so growing it never copies the whole log. Per-node, per-portnum and per-channel
+// posting lists plus a trigram index over text messages are maintained as events
+// arrive, so a query only has to look at the shortest candidate list.
+// Reads are safe from other threads (exports). Appends happen on the GUI thread,
+// except the startup replay which bulk-loads through appendBatch on its own thread.
+class event_store : public QObject
+{
+    Q_OBJECT
+public:
+    explicit event_store(QObject *parent = nullptr);
+
+    quint32 append(const mesh_event& event);
+    // One lock and a single eventsAppended for the whole batch
+    void appendBatch(const QVector<mesh_event>& events);
+    int size() const;
+    mesh_event at(quint32 index) const;
+    // Copies [first, first + maxCount) in one lock, for readers walking the log in batches
+    QVector<mesh_event> range(quint32 first, int maxCount) const;
+    void clear();
+
+    // Indexes of matching events at or after fromIndex, in arrival order. scannedTo gets
+    // the store size the query saw, so a caller can resume from there without gaps or repeats
+    QVector<quint32> query(const event_filter& filter, quint32 fromIndex = 0, quint32* scannedTo = nullptr) const;
+
+signals:
+    void eventsAppended(quint32 first, quint32 last);
+    void cleared();
+
+private:
+    static const int CHUNK_SIZE = 16384;
+    static const int MIN_TEXT_INDEX = 3;
+
+    mutable QReadWriteLock lock;
+    QVector<QVector<mesh_event>> chunks;
+    quint32 count;
+
+    QHash<quint32, QVector<quint32>> byNode;
+    QHash<int, QVector<quint32>> byPortnum;
+    QHash<int, QVector<quint32>> byChannel;
+    QHash<quint64, QVector<quint32>> byTrigram;
+    QVector<quint32> textEvents;
+
+    quint32 insert(const mesh_event& event);
+    const mesh_event& eventAt(quint32 index) const;
+    static quint64 trigram(const QString& text, int pos);
+    static void post(QVector<quint32>& list, quint32 index);
+};
+
+#endif // EVENT_STORE_H
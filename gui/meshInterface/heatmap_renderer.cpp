@@ -0,0 +1,119 @@
+#include "heatmap_renderer.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QDebug>
+
+heatmap_renderer::heatmap_renderer(const node_series* series, QObject *parent)
+    : QObject{parent}
+    , series(series)
+{
+    qRegisterMetaType<QVector<quint32>>();
+
+    // Dark blue through green and yellow to red
+    for (int i = 0; i < 256; ++i) {
+        float t = i / 255.0f;
+        int r = qBound(0, int(255 * qMin(1.0f, 2.0f * t)), 255);
+        int g = qBound(0, int(255 * (t < 0.5f ? 0.3f + 1.4f * t : 2.0f * (1.0f - t))), 255);
+        int b = qBound(0, int(255 * (0.6f - 1.2f * t)), 255);
+        palette[i] = qRgb(r, g, b);
+    }
+}
+
+void heatmap_renderer::start() {
+    timer = new QTimer(this);
+    timer->setInterval(REFRESH_MS);
+    connect(timer, &QTimer::timeout, this, &heatmap_renderer::refresh);
+    timer->start();
+    refresh();
+}
+
+void heatmap_renderer::stop() {
+    if (timer) {
+        timer->stop();
+    }
+}
+
+void heatmap_renderer::setMetric(int column) {
+    metric = static_cast<node_series::Column>(column);
+    // air_util_tx is a node's own share of the hour, rarely more than a few percent
+    scaleMax = metric == node_series::AirUtilTx ? 10.0f : 50.0f;
+    needFull = true;
+    refresh();
+}
+
+QRgb heatmap_renderer::color(float value) const {
+    if (std::isnan(value)) {
+        return emptyColor();
+    }
+    return palette[qBound(0, int(value / scaleMax * 255.0f), 255)];
+}
+
+void heatmap_renderer::fillRow(QImage& image, int y, quint32 node, qint64 fromMs, int buckets) const {
+    QVector<float> means = series->bucketMeans(node, metric, fromMs, BUCKET_MS, buckets);
+    QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+    for (int x = 0; x < buckets; ++x) {
+        line[x] = color(means[x]);
+    }
+}
+
+void heatmap_renderer::renderFull(qint64 nowBucketMs) {
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    // Rows keep the order nodes were first seen in, so a node doesn't move between frames
+    for (quint32 node : series->nodes()) {
+        if (!rowOf.contains(node)) {
+            rowOf.insert(node, rowNodes.size());
+            rowNodes.append(node);
+        }
+    }
+
+    qint64 firstBucketMs = nowBucketMs - (COLUMNS - 1) * BUCKET_MS;
+    QImage image(COLUMNS, qMax(1, int(rowNodes.size())), QImage::Format_RGB32);
+    image.fill(emptyColor());
+    for (int y = 0; y < rowNodes.size(); ++y) {
+        fillRow(image, y, rowNodes[y], firstBucketMs, COLUMNS);
+    }
+    lastBucketMs = nowBucketMs;
+    needFull = false;
+    emit frameReady(image, firstBucketMs, rowNodes);
+    qDebug() << "Heatmap rendered" << rowNodes.size() << "nodes in" << elapsed.elapsed() << "ms";
+}
+
+void heatmap_renderer::refresh() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 nowBucketMs = now - now % BUCKET_MS;
+    // Past a full width of missed buckets an update is no cheaper than a redraw
+    if (needFull || nowBucketMs - lastBucketMs >= COLUMNS * BUCKET_MS) {
+        renderFull(nowBucketMs);
+        return;
+    }
+
+    QVector<quint32> newNodes;
+    for (quint32 node : series->nodes()) {
+        if (!rowOf.contains(node)) {
+            newNodes.append(node);
+        }
+    }
+    if (!newNodes.isEmpty()) {
+        // New rows are filled up to the last rendered bucket, the column pass below does the rest
+        qint64 firstBucketMs = lastBucketMs - (COLUMNS - 1) * BUCKET_MS;
+        QImage rows(COLUMNS, newNodes.size(), QImage::Format_RGB32);
+        for (int i = 0; i < newNodes.size(); ++i) {
+            rowOf.insert(newNodes[i], rowNodes.size());
+            rowNodes.append(newNodes[i]);
+            fillRow(rows, i, newNodes[i], firstBucketMs, COLUMNS);
+        }
+        emit rowsReady(rows, firstBucketMs, newNodes);
+    }
+
+    // The last rendered bucket was still filling up when it was drawn, so it is redone too
+    int buckets = int((nowBucketMs - lastBucketMs) / BUCKET_MS) + 1;
+    QImage columns(buckets, qMax(1, int(rowNodes.size())), QImage::Format_RGB32);
+    columns.fill(emptyColor());
+    for (int y = 0; y < rowNodes.size(); ++y) {
+        fillRow(columns, y, rowNodes[y], lastBucketMs, buckets);
+    }
+    emit columnsReady(columns, lastBucketMs);
+    lastBucketMs = nowBucketMs;
+}
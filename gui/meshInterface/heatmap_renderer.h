@@ -0,0 +1,61 @@
+#ifndef HEATMAP_RENDERER_H
+#define HEATMAP_RENDERER_H
+
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QTimer>
+#include <QVector>
+#include <array>
+#include "node_series.h"
+
+// Colours node_series history into a nodes x time image (one row per node, one
+// column per BUCKET_MS) on a worker thread. Only a metric change (or the first
+// run) renders the whole frame; after that each refresh computes just the columns
+// from the last rendered bucket up to now (the newest one is partial, so it is
+// always redone) and the rows of nodes that appeared since. Pieces are emitted as
+// small images for heatmap_view to copy into its own ring-buffered frame.
+class heatmap_renderer : public QObject
+{
+    Q_OBJECT
+public:
+    static const qint64 BUCKET_MS = 60 * 1000;
+    static const int COLUMNS = 7 * 24 * 60;
+    static const int REFRESH_MS = 5000;
+
+    explicit heatmap_renderer(const node_series* series, QObject *parent = nullptr);
+
+    static QRgb emptyColor() { return qRgb(30, 30, 30); }
+
+public slots:
+    // Called once the object has been moved to its thread
+    void start();
+    void stop();
+    void setMetric(int column);
+    void refresh();
+
+signals:
+    // Full frame, columns in time order starting at firstBucketMs
+    void frameReady(const QImage& image, qint64 firstBucketMs, const QVector<quint32>& rowNodes);
+    // Rows for new nodes, appended below the existing ones, columns as in the last frame
+    void rowsReady(const QImage& rows, qint64 firstBucketMs, const QVector<quint32>& newNodes);
+    // Fresh columns for every row, starting at firstBucketMs
+    void columnsReady(const QImage& columns, qint64 firstBucketMs);
+
+private:
+    const node_series* series;
+    QTimer* timer = nullptr;
+    node_series::Column metric = node_series::ChannelUtilization;
+    float scaleMax = 50.0f;
+    std::array<QRgb, 256> palette;
+    QVector<quint32> rowNodes;
+    QHash<quint32, int> rowOf;
+    qint64 lastBucketMs = 0;
+    bool needFull = true;
+
+    QRgb color(float value) const;
+    void fillRow(QImage& image, int y, quint32 node, qint64 fromMs, int buckets) const;
+    void renderFull(qint64 nowBucketMs);
+};
+
+#endif // HEATMAP_RENDERER_H
@@ -0,0 +1,99 @@
+#include "heatmap_view.h"
+#include "heatmap_renderer.h"
+#include <QDateTime>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QToolTip>
+#include <cstring>
+
+heatmap_view::heatmap_view(QWidget *parent)
+    : QWidget{parent}
+{
+    setMouseTracking(true);
+    setMinimumHeight(120);
+}
+
+int heatmap_view::ringColumn(qint64 bucketMs) {
+    return int((bucketMs / heatmap_renderer::BUCKET_MS) % heatmap_renderer::COLUMNS);
+}
+
+// Each source row is copied in at most two runs, split where the ring wraps
+void heatmap_view::copyColumns(const QImage& source, int destY, qint64 firstBucketMs) {
+    int width = qMin(source.width(), heatmap_renderer::COLUMNS);
+    int start = ringColumn(firstBucketMs);
+    int firstRun = qMin(width, heatmap_renderer::COLUMNS - start);
+    int rows = qMin(source.height(), ring.height() - destY);
+    for (int y = 0; y < rows; ++y) {
+        const QRgb* from = reinterpret_cast<const QRgb*>(source.constScanLine(y));
+        QRgb* to = reinterpret_cast<QRgb*>(ring.scanLine(destY + y));
+        std::memcpy(to + start, from, firstRun * sizeof(QRgb));
+        std::memcpy(to, from + firstRun, (width - firstRun) * sizeof(QRgb));
+    }
+    newestBucketMs = qMax(newestBucketMs, firstBucketMs + (width - 1) * heatmap_renderer::BUCKET_MS);
+}
+
+void heatmap_view::setFrame(const QImage& image, qint64 firstBucketMs, const QVector<quint32>& rowNodes) {
+    nodes = rowNodes;
+    ring = QImage(heatmap_renderer::COLUMNS, image.height(), QImage::Format_RGB32);
+    ring.fill(heatmap_renderer::emptyColor());
+    newestBucketMs = 0;
+    copyColumns(image, 0, firstBucketMs);
+    update();
+}
+
+void heatmap_view::addRows(const QImage& rows, qint64 firstBucketMs, const QVector<quint32>& newNodes) {
+    if (ring.isNull()) {
+        return;
+    }
+    // A single-row frame with no nodes is just a placeholder
+    int keep = nodes.isEmpty() ? 0 : ring.height();
+    QImage grown(heatmap_renderer::COLUMNS, keep + rows.height(), QImage::Format_RGB32);
+    for (int y = 0; y < keep; ++y) {
+        std::memcpy(grown.scanLine(y), ring.constScanLine(y), ring.bytesPerLine());
+    }
+    ring = grown;
+    nodes += newNodes;
+    copyColumns(rows, keep, firstBucketMs);
+    update();
+}
+
+void heatmap_view::updateColumns(const QImage& columns, qint64 firstBucketMs) {
+    if (ring.isNull()) {
+        return;
+    }
+    copyColumns(columns, 0, firstBucketMs);
+    update();
+}
+
+void heatmap_view::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(heatmap_renderer::emptyColor()));
+    if (ring.isNull()) {
+        return;
+    }
+
+    // Oldest column sits just after the newest one; draw it on the left
+    const int columns = heatmap_renderer::COLUMNS;
+    int oldest = (ringColumn(newestBucketMs) + 1) % columns;
+    double scale = double(width()) / columns;
+    double leftWidth = (columns - oldest) * scale;
+    painter.drawImage(QRectF(0, 0, leftWidth, height()), ring, QRectF(oldest, 0, columns - oldest, ring.height()));
+    if (oldest > 0) {
+        painter.drawImage(QRectF(leftWidth, 0, width() - leftWidth, height()), ring, QRectF(0, 0, oldest, ring.height()));
+    }
+}
+
+void heatmap_view::mouseMoveEvent(QMouseEvent *event) {
+    if (nodes.isEmpty() || width() <= 0 || height() <= 0) {
+        return;
+    }
+    QPointF pos = event->position();
+    int row = qBound(0, int(pos.y() * nodes.size() / height()), int(nodes.size()) - 1);
+    int column = qBound(0, int(pos.x() * heatmap_renderer::COLUMNS / width()), heatmap_renderer::COLUMNS - 1);
+    qint64 bucketMs = newestBucketMs - (heatmap_renderer::COLUMNS - 1 - column) * heatmap_renderer::BUCKET_MS;
+    QToolTip::showText(event->globalPosition().toPoint(),
+                       QString("!%1  %2").arg(nodes[row], 8, 16, QChar('0'))
+                           .arg(QDateTime::fromMSecsSinceEpoch(bucketMs).toString("ddd hh:mm")),
+                       this);
+}
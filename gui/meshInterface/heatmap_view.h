@@ -0,0 +1,36 @@
+#ifndef HEATMAP_VIEW_H
+#define HEATMAP_VIEW_H
+
+#include <QWidget>
+#include <QImage>
+#include <QVector>
+
+// Shows what heatmap_renderer produces. The frame is kept as a ring over time:
+// a bucket always lands in column (bucket / BUCKET_MS) % COLUMNS, so new columns
+// are copied over the oldest ones in place and painting is two blits, one on each
+// side of the newest column.
+class heatmap_view : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit heatmap_view(QWidget *parent = nullptr);
+
+public slots:
+    void setFrame(const QImage& image, qint64 firstBucketMs, const QVector<quint32>& rowNodes);
+    void addRows(const QImage& rows, qint64 firstBucketMs, const QVector<quint32>& newNodes);
+    void updateColumns(const QImage& columns, qint64 firstBucketMs);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    QImage ring;
+    QVector<quint32> nodes;
+    qint64 newestBucketMs = 0;
+
+    static int ringColumn(qint64 bucketMs);
+    void copyColumns(const QImage& source, int destY, qint64 firstBucketMs);
+};
+
+#endif // HEATMAP_VIEW_H
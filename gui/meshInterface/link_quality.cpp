@@ -0,0 +1,88 @@
+#include "link_quality.h"
+
+void link_quality::Metric::add(float value, qint64 timestampMs, const Scale& scale) {
+    ewma = std::isnan(ewma) ? value : ewma + EWMA_ALPHA * (value - ewma);
+    samples++;
+
+    qint64 start = timestampMs - timestampMs % SLOT_MS;
+    Slot& slot = slots[(start / SLOT_MS) % SLOTS];
+    if (slot.startMs > start) {
+        return; // late sample for a minute this slot has already moved past
+    }
+    if (slot.startMs != start) {
+        // This slot last held a minute that has left the window
+        slot = Slot();
+        slot.startMs = start;
+    }
+
+    int bin = qBound(0, int((value - scale.lowest) / scale.binWidth), BINS - 1);
+    if (slot.bins[bin] == 0xffff) {
+        return; // a full bin only costs that slot's quantile accuracy, never wraps
+    }
+    slot.bins[bin]++;
+    slot.count++;
+    slot.min = std::isnan(slot.min) ? value : qMin(slot.min, value);
+    slot.max = std::isnan(slot.max) ? value : qMax(slot.max, value);
+}
+
+link_stats link_quality::Metric::stats(qint64 nowMs, const Scale& scale) const {
+    link_stats result;
+    result.ewma = ewma;
+
+    std::array<quint32, BINS> merged{};
+    qint64 oldest = nowMs - nowMs % SLOT_MS - (SLOTS - 1) * SLOT_MS;
+    for (const Slot& slot : slots) {
+        if (slot.count == 0 || slot.startMs < oldest) {
+            continue;
+        }
+        result.samples += slot.count;
+        result.min = std::isnan(result.min) ? slot.min : qMin(result.min, slot.min);
+        result.max = std::isnan(result.max) ? slot.max : qMax(result.max, slot.max);
+        for (int i = 0; i < BINS; ++i) {
+            merged[i] += slot.bins[i];
+        }
+    }
+    if (result.samples == 0) {
+        return result;
+    }
+
+    // Each quantile is reported as its bin's midpoint, kept inside the exact min/max
+    float* targets[] = {&result.p10, &result.p50, &result.p90};
+    const double fractions[] = {0.1, 0.5, 0.9};
+    int next = 0;
+    quint32 cumulative = 0;
+    for (int i = 0; i < BINS && next < 3; ++i) {
+        cumulative += merged[i];
+        while (next < 3 && cumulative >= fractions[next] * result.samples && cumulative > 0) {
+            float mid = scale.lowest + (i + 0.5f) * scale.binWidth;
+            *targets[next] = qBound(result.min, mid, result.max);
+            next++;
+        }
+    }
+    return result;
+}
+
+bool link_quality::update(const mesh_event& event) {
+    // rxSnr/rxRssi measure the last hop, on a relayed packet that is the relay's link, not the sender's
+    if (event.from == 0 || event.hopsAway() != 0 || (!event.hasSnr() && event.rxRssi == 0)) {
+        return false;
+    }
+    Node& node = nodes[event.from];
+    if (event.hasSnr()) {
+        node.snr.add(event.rxSnr, event.timestampMs, SNR_SCALE);
+    }
+    if (event.rxRssi != 0) {
+        node.rssi.add(float(event.rxRssi), event.timestampMs, RSSI_SCALE);
+    }
+    return true;
+}
+
+link_summary link_quality::summary(quint32 node, qint64 nowMs) const {
+    link_summary result;
+    auto it = nodes.constFind(node);
+    if (it != nodes.constEnd()) {
+        result.snr = it->snr.stats(nowMs, SNR_SCALE);
+        result.rssi = it->rssi.stats(nowMs, RSSI_SCALE);
+    }
+    return result;
+}
@@ -0,0 +1,78 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <QHash>
+#include <array>
+#include "mesh_event.h"
+
+struct link_stats
+{
+    int samples = 0;
+    float ewma = NAN;
+    float min = NAN;
+    float max = NAN;
+    float p10 = NAN;
+    float p50 = NAN;
+    float p90 = NAN;
+};
+
+struct link_summary
+{
+    link_stats snr;
+    link_stats rssi;
+};
+
+// Per-node SNR/RSSI statistics in constant memory. Each metric keeps an EWMA
+// over every sample plus a sliding window of SLOTS one-minute slots; every slot
+// is a fixed-bin histogram (HDR-style, fixed resolution over a fixed range) with
+// its own min/max. Quantiles come from summing the live slots' bins, and a slot
+// is cleared when the window moves past it, so old samples age out exactly.
+class link_quality
+{
+public:
+    static const int SLOTS = 15;
+    static const qint64 SLOT_MS = 60 * 1000;
+    static constexpr float EWMA_ALPHA = 0.2f;
+
+    // Only packets heard directly (hopsAway() == 0) are recorded, returns whether this one was
+    bool update(const mesh_event& event);
+    link_summary summary(quint32 node, qint64 nowMs) const;
+    bool contains(quint32 node) const { return nodes.contains(node); }
+    void clear() { nodes.clear(); }
+
+private:
+    // Histogram range and resolution per metric; values outside are clamped to the end bins
+    struct Scale {
+        float lowest;
+        float binWidth;
+    };
+    static const int BINS = 128;
+    static constexpr Scale SNR_SCALE = {-32.0f, 0.5f};   // -32 .. +32 dB
+    static constexpr Scale RSSI_SCALE = {-150.0f, 1.0f}; // -150 .. -22 dBm
+
+    struct Slot {
+        qint64 startMs = 0;
+        float min = NAN;
+        float max = NAN;
+        quint16 count = 0;
+        std::array<quint16, BINS> bins{};
+    };
+
+    struct Metric {
+        float ewma = NAN;
+        int samples = 0;
+        std::array<Slot, SLOTS> slots;
+
+        void add(float value, qint64 timestampMs, const Scale& scale);
+        link_stats stats(qint64 nowMs, const Scale& scale) const;
+    };
+
+    struct Node {
+        Metric snr;
+        Metric rssi;
+    };
+
+    QHash<quint32, Node> nodes;
+};
+
+#endif // LINK_QUALITY_H
@@ -0,0 +1,231 @@
+#include "log_sink.h"
+#include <QDir>
+#include <QThreadPool>
+#include <QDebug>
+#include <zlib.h>
+
+log_sink::log_sink(const QString& directory, QObject *parent)
+    : QThread{parent}
+    , directory(directory)
+    , maxSegmentBytes(16 * 1024 * 1024)
+    , maxSegmentAgeSecs(60 * 60)
+    , maxSegments(100)
+    , ring(QUEUE_CAPACITY)
+    , dropped(0)
+    , written(0)
+{
+    QDir().mkpath(directory);
+}
+
+log_sink::~log_sink() {
+    stop();
+}
+
+QString log_sink::currentSegment() const {
+    QMutexLocker locker(&mutex);
+    return segmentName;
+}
+
+void log_sink::stop() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+    }
+    wake.wakeOne();
+    wait();
+}
+
+void log_sink::append(const mesh_event& event) {
+    {
+        QMutexLocker locker(&mutex);
+        if (count == QUEUE_CAPACITY || stopping) {
+            dropped++;
+            return;
+        }
+        ring[(head + count) % QUEUE_CAPACITY] = event;
+        count++;
+    }
+    wake.wakeOne();
+}
+
+bool log_sink::openSegment() {
+    segmentOpened = QDateTime::currentDateTime();
+    QString name = QDir(directory).filePath(
+        QString("meshmonitor-%1.log").arg(segmentOpened.toString("yyyyMMdd-hhmmss-zzz")));
+
+    segment.setFileName(name);
+    if (!segment.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        // Retried every RETRY_MS, only the first failure in a row is worth a line
+        if (!openFailed) {
+            qDebug() << "Log sink: could not open" << name << segment.errorString();
+        }
+        openFailed = true;
+        retryAtMs = QDateTime::currentMSecsSinceEpoch() + RETRY_MS;
+        QMutexLocker locker(&mutex);
+        segmentName.clear();
+        return false;
+    }
+    openFailed = false;
+    QMutexLocker locker(&mutex);
+    segmentName = name;
+    return true;
+}
+
+void log_sink::closeSegment() {
+    if (!segment.isOpen()) {
+        return;
+    }
+    segment.close();
+    QString closed = segment.fileName();
+    emit segmentClosed(closed);
+
+    // Compression runs on the pool so the writer can go straight back to draining the queue
+    QThreadPool::globalInstance()->start([closed]() {
+        if (!compressSegment(closed)) {
+            qDebug() << "Log sink: could not compress" << closed;
+        }
+    });
+    pruneSegments();
+}
+
+// Keep at most maxSegments closed segments, oldest go first. The one just closed is
+// usually still being compressed, it counts under its .log name until the .gz exists
+void log_sink::pruneSegments() {
+    QDir dir(directory);
+    QStringList closed;
+    for (QString name : dir.entryList({"meshmonitor-*.log", "meshmonitor-*.log.gz"}, QDir::Files, QDir::Name)) {
+        if (name.endsWith(".gz")) {
+            name.chop(3);
+        }
+        // Sorted by name, a segment caught mid-compression is listed twice in a row
+        if (closed.isEmpty() || closed.last() != name) {
+            closed.append(name);
+        }
+    }
+    int excess = closed.size() - maxSegments.load();
+    for (int i = 0; i < excess; ++i) {
+        dir.remove(closed[i]);
+        dir.remove(closed[i] + ".gz");
+    }
+}
+
+bool log_sink::compressSegment(const QString& fileName) {
+    QFile in(fileName);
+    if (!in.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QString gzName = fileName + ".gz";
+    gzFile out = gzopen(QFile::encodeName(gzName).constData(), "wb6");
+    if (!out) {
+        return false;
+    }
+
+    QByteArray buffer(256 * 1024, Qt::Uninitialized);
+    bool ok = true;
+    qint64 n;
+    while ((n = in.read(buffer.data(), buffer.size())) > 0) {
+        if (gzwrite(out, buffer.constData(), static_cast<unsigned>(n)) != n) {
+            ok = false;
+            break;
+        }
+    }
+    ok = gzclose(out) == Z_OK && ok && n == 0;
+    in.close();
+
+    if (ok) {
+        QFile::remove(fileName);
+    } else {
+        QFile::remove(gzName);
+    }
+    return ok;
+}
+
+void log_sink::run() {
+    QVector<mesh_event> batch;
+    batch.reserve(QUEUE_CAPACITY);
+    quint64 reportedDrops = 0;
+    QByteArray out;
+
+    // Segments left open by the previous run are compressed like any other closed segment
+    QDir dir(directory);
+    for (const QString& leftover : dir.entryList({"meshmonitor-*.log"}, QDir::Files)) {
+        QString fileName = dir.filePath(leftover);
+        QThreadPool::globalInstance()->start([fileName]() { compressSegment(fileName); });
+    }
+
+    openSegment();
+
+    while (true) {
+        bool exiting;
+        {
+            QMutexLocker locker(&mutex);
+            if (count == 0 && !stopping) {
+                // Wake up now and then even when idle so old segments still rotate by age
+                wake.wait(&mutex, 1000);
+            }
+            while (count > 0) {
+                batch.append(std::move(ring[head]));
+                ring[head] = mesh_event();
+                head = (head + 1) % QUEUE_CAPACITY;
+                count--;
+            }
+            exiting = stopping;
+        }
+
+        // No segment (an open, rotation or write failed): try again once the back-off has passed,
+        // and count the batch as lost until a segment is open
+        if (!segment.isOpen() && (QDateTime::currentMSecsSinceEpoch() < retryAtMs || !openSegment())) {
+            dropped += batch.size();
+            batch.clear();
+            if (exiting) {
+                break;
+            }
+            continue;
+        }
+
+        quint64 drops = dropped.load();
+        if (drops != reportedDrops) {
+            out += QDateTime::currentDateTime().toString(Qt::ISODateWithMs).toUtf8();
+            out += " [SINK] dropped " + QByteArray::number(drops - reportedDrops) + " events\n";
+        }
+        for (const mesh_event& event : batch) {
+            out += QDateTime::fromMSecsSinceEpoch(event.timestampMs).toString(Qt::ISODateWithMs).toUtf8();
+            out += " [" + event.level.toUtf8() + "] " + event.json + '\n';
+        }
+
+        if (!out.isEmpty()) {
+            if (segment.write(out) == out.size() && segment.flush()) {
+                written += batch.size();
+                reportedDrops = drops;
+            } else {
+                // Disk full or an I/O error: the batch is lost, and the segment is closed so the
+                // next flush opens a fresh one and reports the gap
+                qDebug() << "Log sink: write to" << segment.fileName() << "failed" << segment.errorString();
+                dropped += batch.size();
+                closeSegment();
+                retryAtMs = QDateTime::currentMSecsSinceEpoch() + RETRY_MS;
+            }
+        }
+        batch.clear();
+        out.clear();
+
+        if (exiting) {
+            break;
+        }
+
+        if (!segment.isOpen()) {
+            continue;
+        }
+        // An empty segment is never rotated, it would only produce empty archives while idle
+        qint64 size = segment.size();
+        if (size >= maxSegmentBytes.load() ||
+            (size > 0 && segmentOpened.secsTo(QDateTime::currentDateTime()) >= maxSegmentAgeSecs.load())) {
+            closeSegment();
+            // A failure leaves no segment open, run() retries after RETRY_MS
+            openSegment();
+        }
+    }
+
+    // The last segment stays uncompressed until the next start
+    segment.close();
+}
@@ -0,0 +1,78 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QDateTime>
+#include <QVector>
+#include <atomic>
+#include "mesh_event.h"
+
+// Always-on log of every event. append() only copies the event into a bounded
+// ring and returns; a background thread formats and writes it, rotating to a new
+// segment by size or age. Closed segments are gzipped on the thread pool.
+// When the writer can't keep up, events are dropped and counted instead of
+// ever stalling ingest. The same goes for events that can't be written (no segment
+// could be opened, or a write failed); a new segment is tried every RETRY_MS.
+class log_sink : public QThread
+{
+    Q_OBJECT
+public:
+    explicit log_sink(const QString& directory, QObject *parent = nullptr);
+    ~log_sink();
+
+    void setMaxSegmentBytes(qint64 bytes) { maxSegmentBytes = bytes; }
+    void setMaxSegmentAge(qint64 seconds) { maxSegmentAgeSecs = seconds; }
+    void setMaxSegments(int count) { maxSegments = count; }
+
+    quint64 droppedCount() const { return dropped.load(); }
+    quint64 writtenCount() const { return written.load(); }
+    QString currentSegment() const;
+
+    void stop();
+
+public slots:
+    void append(const mesh_event& event);
+
+signals:
+    void segmentClosed(const QString& fileName);
+
+protected:
+    void run() override;
+
+private:
+    static const int QUEUE_CAPACITY = 8192;
+    // After a failed open or write, so a full disk doesn't turn every flush into a new segment
+    static const qint64 RETRY_MS = 5000;
+
+    QString directory;
+    std::atomic<qint64> maxSegmentBytes;
+    std::atomic<qint64> maxSegmentAgeSecs;
+    std::atomic<int> maxSegments;
+
+    mutable QMutex mutex;
+    QWaitCondition wake;
+    QVector<mesh_event> ring;
+    int head = 0;
+    int count = 0;
+    bool stopping = false;
+
+    std::atomic<quint64> dropped;
+    std::atomic<quint64> written;
+
+    // Only touched by the writer thread (segment name also read under mutex)
+    QFile segment;
+    QString segmentName;
+    QDateTime segmentOpened;
+    bool openFailed = false;
+    qint64 retryAtMs = 0;
+
+    bool openSegment();
+    void closeSegment();
+    void pruneSegments();
+    static bool compressSegment(const QString& fileName);
+};
+
+#endif // LOG_SINK_H
@@ -0,0 +1,128 @@
+#include "lora_airtime.h"
+#include <cmath>
+
+namespace {
+const int PRESET_COUNT = meshtastic::Config_LoRaConfig_ModemPreset_SHORT_TURBO + 1;
+
+// Data protobuf framing (portnum and payload tags, lengths) around the application bytes
+const int DATA_OVERHEAD = 4;
+
+// Bandwidth codes the firmware's RadioInterface maps to fractional kHz
+const struct { uint32_t code; double khz; } FRACTIONAL_BANDWIDTHS[] = {
+    {31, 31.25}, {62, 62.5}, {200, 203.125}, {400, 406.25}, {800, 812.5}, {1600, 1625.0},
+};
+}
+
+lora_airtime::lora_airtime(const lora_params& params)
+    : current(params)
+{
+    for (int bytes = 0; bytes <= MAX_FRAME; ++bytes) {
+        table[bytes] = float(frameAirtimeMs(current, bytes));
+    }
+}
+
+// Same values as the firmware's modem preset table
+lora_params lora_airtime::presetParams(meshtastic::Config_LoRaConfig_ModemPreset preset) {
+    lora_params params;
+    switch (static_cast<int>(preset)) {
+    case meshtastic::Config_LoRaConfig_ModemPreset_SHORT_TURBO:   params = {500.0, 7, 5, 16}; break;
+    case meshtastic::Config_LoRaConfig_ModemPreset_SHORT_FAST:    params = {250.0, 7, 5, 16}; break;
+    case meshtastic::Config_LoRaConfig_ModemPreset_SHORT_SLOW:    params = {250.0, 8, 5, 16}; break;
+    case meshtastic::Config_LoRaConfig_ModemPreset_MEDIUM_FAST:   params = {250.0, 9, 5, 16}; break;
+    case meshtastic::Config_LoRaConfig_ModemPreset_MEDIUM_SLOW:   params = {250.0, 10, 5, 16}; break;
+    case meshtastic::Config_LoRaConfig_ModemPreset_LONG_MODERATE: params = {125.0, 11, 8, 16}; break;
+    case meshtastic::Config_LoRaConfig_ModemPreset_LONG_SLOW:     params = {125.0, 12, 8, 16}; break;
+    case VERY_LONG_SLOW:                                           params = {62.5, 12, 8, 16}; break;
+    default: /* LONG_FAST */                                       params = {250.0, 11, 5, 16}; break;
+    }
+    return params;
+}
+
+double lora_airtime::bandwidthKhz(uint32_t code) {
+    for (const auto& bandwidth : FRACTIONAL_BANDWIDTHS) {
+        if (bandwidth.code == code) {
+            return bandwidth.khz;
+        }
+    }
+    return code;
+}
+
+uint32_t lora_airtime::bandwidthCode(double khz) {
+    for (const auto& bandwidth : FRACTIONAL_BANDWIDTHS) {
+        if (std::fabs(bandwidth.khz - khz) < 0.01) {
+            return bandwidth.code;
+        }
+    }
+    return uint32_t(std::lround(khz));
+}
+
+bool lora_airtime::usesPreset(const meshtastic::Config_LoRaConfig& config) {
+    return config.use_preset() || config.bandwidth() == 0 || config.spread_factor() == 0;
+}
+
+lora_params lora_airtime::configParams(const meshtastic::Config_LoRaConfig& config) {
+    if (usesPreset(config)) {
+        return presetParams(config.modem_preset());
+    }
+    lora_params params;
+    params.bandwidthKhz = bandwidthKhz(config.bandwidth());
+    params.spreadingFactor = qBound(5, int(config.spread_factor()), 12);
+    params.codingRate = qBound(5, int(config.coding_rate()), 8);
+    return params;
+}
+
+const lora_airtime& lora_airtime::forPreset(meshtastic::Config_LoRaConfig_ModemPreset preset) {
+    static const std::array<lora_airtime, PRESET_COUNT> presets = [] {
+        std::array<lora_airtime, PRESET_COUNT> tables;
+        for (int i = 0; i < PRESET_COUNT; ++i) {
+            tables[i] = lora_airtime(presetParams(static_cast<meshtastic::Config_LoRaConfig_ModemPreset>(i)));
+        }
+        return tables;
+    }();
+    int index = static_cast<int>(preset);
+    return presets[index >= 0 && index < PRESET_COUNT ? index : 0];
+}
+
+lora_airtime lora_airtime::forConfig(const meshtastic::Config_LoRaConfig& config) {
+    if (usesPreset(config)) {
+        return forPreset(config.modem_preset());
+    }
+    return lora_airtime(configParams(config));
+}
+
+double lora_airtime::frameAirtimeMs(const lora_params& params, int frameBytes) {
+    int sf = params.spreadingFactor;
+    double symbolMs = std::pow(2.0, sf) / params.bandwidthKhz;
+    int lowDataRate = symbolMs > 16.0 ? 1 : 0;
+
+    double preambleMs = (params.preambleSymbols + 4.25) * symbolMs;
+    // 16 bits of CRC, explicit header (IH = 0)
+    double numerator = 8.0 * frameBytes - 4.0 * sf + 28 + 16;
+    double symbols = std::ceil(numerator / (4.0 * (sf - 2 * lowDataRate))) * params.codingRate;
+    double payloadSymbols = 8 + qMax(symbols, 0.0);
+    return preambleMs + payloadSymbols * symbolMs;
+}
+
+int lora_airtime::payloadBytes(const mesh_event& event) {
+    if (event.payloadLength >= 0) {
+        return event.payloadLength;
+    }
+    if (!event.text.isEmpty()) {
+        return event.text.toUtf8().size() + DATA_OVERHEAD;
+    }
+    // Typical encoded sizes seen for each application
+    switch (event.portnum) {
+    case 1: return 24;   // TEXT_MESSAGE_APP without the text
+    case 3: return 32;   // POSITION_APP
+    case 4: return 64;   // NODEINFO_APP
+    case 5: return 8;    // ROUTING_APP (acks)
+    case 67: return 32;  // TELEMETRY_APP
+    case 70: return 24;  // TRACEROUTE_APP
+    case 71: return 48;  // NEIGHBORINFO_APP
+    default: return 32;
+    }
+}
+
+double lora_airtime::airtimeMs(int payloadBytes) const {
+    return table[qBound(0, HEADER_BYTES + payloadBytes, MAX_FRAME)];
+}
@@ -0,0 +1,60 @@
+#ifndef LORA_AIRTIME_H
+#define LORA_AIRTIME_H
+
+#include <array>
+#include "mesh_event.h"
+#include "meshtastic/config.pb.h"
+
+struct lora_params
+{
+    double bandwidthKhz = 250.0;
+    int spreadingFactor = 11;
+    // Denominator of the 4/x coding rate, 5..8
+    int codingRate = 5;
+    int preambleSymbols = 16;
+};
+
+// Time on air of a LoRa frame (Semtech AN1200.13 formula, explicit header, CRC on,
+// low data rate optimisation when a symbol is longer than 16 ms). Airtime for every
+// possible frame size is worked out once per set of radio parameters, so looking a
+// packet up is an array index. Tables for the Meshtastic modem presets are built
+// once and shared.
+class lora_airtime
+{
+public:
+    static const int MAX_FRAME = 255;
+    // Meshtastic's unencrypted header (to, from, id, flags, channel, next hop, relay)
+    static const int HEADER_BYTES = 16;
+    // Deprecated in the protobuf (so naming it warns), old firmware still reports it
+    static constexpr meshtastic::Config_LoRaConfig_ModemPreset VERY_LONG_SLOW =
+        static_cast<meshtastic::Config_LoRaConfig_ModemPreset>(2);
+
+    explicit lora_airtime(const lora_params& params = lora_params());
+
+    static lora_params presetParams(meshtastic::Config_LoRaConfig_ModemPreset preset);
+    // Whether the config runs a modem preset rather than explicit bandwidth/SF/CR
+    static bool usesPreset(const meshtastic::Config_LoRaConfig& config);
+    // Preset when usesPreset, otherwise the explicit bandwidth/SF/CR
+    static lora_params configParams(const meshtastic::Config_LoRaConfig& config);
+    // LoRaConfig.bandwidth holds whole kHz, a few of those codes stand for fractional widths
+    static double bandwidthKhz(uint32_t code);
+    // Inverse of bandwidthKhz, for widths the firmware prints in kHz
+    static uint32_t bandwidthCode(double khz);
+    static const lora_airtime& forPreset(meshtastic::Config_LoRaConfig_ModemPreset preset);
+    // The shared preset table when the config runs a preset, otherwise a table built for it
+    static lora_airtime forConfig(const meshtastic::Config_LoRaConfig& config);
+    static double frameAirtimeMs(const lora_params& params, int frameBytes);
+    // Decoded payload size: the firmware's len= when it was printed, else a typical size for the port
+    static int payloadBytes(const mesh_event& event);
+
+    const lora_params& params() const { return current; }
+    // Airtime of a packet carrying payloadBytes after the mesh header
+    double airtimeMs(int payloadBytes) const;
+    double airtimeMs(const mesh_event& event) const { return airtimeMs(payloadBytes(event)); }
+
+private:
+    lora_params current;
+    std::array<float, MAX_FRAME + 1> table;
+};
+
+#endif // LORA_AIRTIME_H
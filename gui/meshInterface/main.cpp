@@ -1,4 +1,5 @@
 #include "loginWindow.h"
+#include "tile_cache.h"
 
 #include <QApplication>
 #include <QMessageBox>
@@ -6,11 +7,18 @@
 #include <iostream>
 #include <QMainWindow>
 #include <QScreen>
+#include <QElapsedTimer>
 
 using namespace std;
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
+    // Custom URL schemes have to be known before the web engine starts
+    tile_cache::registerUrlScheme();
+
     QApplication a(argc, argv);
     MainWindow w;
 
@@ -25,6 +33,7 @@ int main(int argc, char *argv[])
     }
 
     w.show();
+    qDebug() << "[STARTUP] Login window shown after" << startupTimer.elapsed() << "ms";
     return a.exec();
 
 }
@@ -13,13 +13,42 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QTextStream>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStatusBar>
+#include <QHeaderView>
+#include <QWebEngineProfile>
+#include <QStandardPaths>
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QMenu>
+#include <QComboBox>
+#include <QSet>
 
 MainApp::MainApp(QWidget *parent)
     : QMainWindow{parent}
     , ui(new Ui::MainWindow)
     , meshHandler(nullptr)
+    , mapView(nullptr)
+    , eventStore(nullptr)
+    , filterModel(nullptr)
+    , filterTimer(nullptr)
+    , nodeTable(nullptr)
+    , nodeSort(nullptr)
+    , snapshotTimer(nullptr)
+    , exportThread(nullptr)
+    , exporter(nullptr)
+    , exportProgress(nullptr)
+    , mapBridge(nullptr)
+    , mapChannel(nullptr)
+    , tileCache(nullptr)
+    , mapRenderTimer(nullptr)
 {
     //main constuctor
+    QElapsedTimer startupTimer;
+    startupTimer.start();
     ui->setupUi(this);
 
     ui->debug_check->setChecked(false);
@@ -80,16 +109,237 @@ MainApp::MainApp(QWidget *parent)
         }
     });
 
+    // Rebroadcasts of a packet already heard are counted here and, if asked, dropped
+    // before they reach the views and stores. The log sink still records everything.
+    duplicateFilter = new duplicate_filter(this);
+    connect(meshHandler, &meshtastic_handler::eventParsed, this, [this](const mesh_event& event) {
+        // Range and bearing from our own position are attached before anything else sees the event
+        mesh_event located = event;
+        rangeBearing.lookup(located.from, located.distanceKm, located.bearingDeg);
+        duplicateFilter->process(located);
+    });
+    connect(meshHandler, &meshtastic_handler::localPositionUpdate, this, [this](double lat, double lon) {
+        onLocalPosition(lat, lon);
+    });
+    connect(ui->hide_duplicates_check, &QCheckBox::toggled, duplicateFilter, &duplicate_filter::setSuppress);
+    connect(duplicateFilter, &duplicate_filter::duplicateSeen, this, [this]() {
+        ui->hide_duplicates_check->setToolTip(QString("%1 duplicates of %2 packets heard")
+                                              .arg(duplicateFilter->duplicateCount())
+                                              .arg(duplicateFilter->seenCount()));
+    });
+
+    // Every parsed event is kept and indexed for the filter bar
+    eventStore = new event_store(this);
+    filterModel = new event_filter_model(eventStore, this);
+    ui->filter_view->setModel(filterModel);
+    ui->filter_view->hide();
+
+    // Everything is also written to rotating log segments in AppData/logs
+    logSink = new log_sink(QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("logs"), this);
+    connect(meshHandler, &meshtastic_handler::eventParsed, logSink, &log_sink::append);
+    logSink->start(QThread::LowPriority);
+
+    // Events are persisted to SQLite from the store's own thread (see packet_store)
+    storeThread = new QThread(this);
+    packetDbPath = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("meshmonitor_packets.db");
+    packetStore = new packet_store(packetDbPath);
+    packetStore->moveToThread(storeThread);
+    connect(storeThread, &QThread::started, packetStore, &packet_store::open);
+    connect(storeThread, &QThread::finished, packetStore, &QObject::deleteLater);
+    // append() only queues under a lock, call it directly instead of posting every event to the thread
+    connect(duplicateFilter, &duplicate_filter::eventAccepted, packetStore, &packet_store::append, Qt::DirectConnection);
+    connect(packetStore, &packet_store::databaseError, this, [this](const QString& error) {
+        statusBar()->showMessage(error, 10000);
+    });
+    storeThread->start();
+
+    // The event store, per-node metric columns and binary event log are fed together in recordEvent.
+    // The last day of the log is replayed into the first two on its own thread so startup doesn't wait for it
+    replayThread = new QThread(this);
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    replay = new event_replay(&eventLog, QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("eventlog"),
+                              eventStore, &nodeSeries, now - 24 * 60 * 60 * 1000, now);
+    replay->moveToThread(replayThread);
+    connect(replayThread, &QThread::started, replay, &event_replay::run);
+    connect(replayThread, &QThread::finished, replay, &QObject::deleteLater);
+    connect(replay, &event_replay::finished, this, &MainApp::onReplayFinished);
+    connect(duplicateFilter, &duplicate_filter::eventAccepted, this, &MainApp::recordEvent);
+    replayThread->start(QThread::LowPriority);
+
+    // Live node list, sorted by last heard until a header is clicked
+    nodeTable = new node_table_model(this);
+    connect(duplicateFilter, &duplicate_filter::eventAccepted, nodeTable, &node_table_model::updateFromEvent);
+    connect(duplicateFilter, &duplicate_filter::eventAccepted, this, [this](const mesh_event& event) {
+        if (linkQuality.update(event)) {
+            nodeTable->updateLinkQuality(event.from, linkQuality.summary(event.from, event.timestampMs));
+        }
+    });
+
+    // Mesh topology from hop counts, relay hints and NeighborInfo reports. Fed before the duplicate
+    // filter, a rebroadcast copy is often the only one that names a relay
+    connect(meshHandler, &meshtastic_handler::eventParsed, this, [this](const mesh_event& event) {
+        topology.addEvent(event);
+    });
+    connect(meshHandler, &meshtastic_handler::neighborInfo, this,
+            [this](quint32 node, const QVector<QPair<quint32, float>>& neighbors, qint64 timestampMs) {
+        topology.addNeighborInfo(node, neighbors, timestampMs);
+    });
+    connect(meshHandler, &meshtastic_handler::localNodeDetected, this, [this](quint32 node) {
+        topology.setLocalNode(node);
+    });
+    // Paths and cut vertices for the node table, on the graph's own cache period
+    topologyTimer = new QTimer(this);
+    topologyTimer->setInterval(topology_graph::CACHE_MS);
+    connect(topologyTimer, &QTimer::timeout, this, &MainApp::refreshTopology);
+    topologyTimer->start();
+
+    // Airtime from every copy heard, duplicates included, since each one took the channel
+    connect(meshHandler, &meshtastic_handler::loraConfigDetected, this, [this](const meshtastic::Config_LoRaConfig& config) {
+        airtime.setConfig(config);
+    });
+    connect(meshHandler, &meshtastic_handler::eventParsed, this, [this](const mesh_event& event) {
+        airtime.add(event);
+        if (nodeTable->rowForNode(event.from) >= 0) {
+            nodeTable->updateAirtime(event.from, airtime.check(event.from, event.timestampMs));
+        }
+    });
+
+    // Battery drain per node from telemetry, and from the local firmware's own battery reports
+    connect(duplicateFilter, &duplicate_filter::eventAccepted, this, [this](const mesh_event& event) {
+        if (event.from != 0 && event.batteryLevel >= 0) {
+            onBatterySample(event.from, batteryTrend.add(event.from, float(event.batteryLevel), event.timestampMs));
+        }
+    });
+    // Until the local node number is known its samples are kept under 0, which no remote node uses
+    connect(meshHandler, &meshtastic_handler::localBattery, this,
+            [this](quint32 node, int percent, bool externalPower, qint64 timestampMs) {
+        onBatterySample(node, batteryTrend.add(node, float(percent), timestampMs, externalPower));
+    });
+    connect(meshHandler, &meshtastic_handler::localNodeDetected, this, [this](quint32 node) {
+        batteryTrend.rekey(0, node);
+        nodeTable->updateBattery(node, batteryTrend.estimate(node));
+    });
+
+    // Periodic traceroutes to the nodes picked from the node table's context menu
+    traceroutes = new traceroute_tracker(this);
+    connect(traceroutes, &traceroute_tracker::requestTrace, meshHandler, &meshtastic_handler::sendTraceroute);
+    connect(meshHandler, &meshtastic_handler::tracerouteFailed, traceroutes, &traceroute_tracker::onSendFailed);
+    connect(meshHandler, &meshtastic_handler::apiSessionChanged, traceroutes, &traceroute_tracker::setActive);
+    connect(meshHandler, &meshtastic_handler::routeDiscovered, traceroutes, &traceroute_tracker::onRouteReply);
+    connect(traceroutes, &traceroute_tracker::traceCompleted, packetStore, &packet_store::appendRoute);
+    connect(traceroutes, &traceroute_tracker::traceCompleted, this, [this](const route_trace& trace) {
+        topology.addRoute(trace.forward, trace.snrTowards, trace.timestampMs);
+        if (trace.hasBack()) {
+            topology.addRoute(trace.back, trace.snrBack, trace.timestampMs);
+        }
+        route_stats stats = traceroutes->stats(trace.target);
+        statusBar()->showMessage(QString("Route to !%1: %2 hops, rtt %3 s, stability %4%, asymmetric %5%")
+                                 .arg(trace.target, 8, 16, QChar('0'))
+                                 .arg(trace.hops())
+                                 .arg(trace.rttMs >= 0 ? QString::number(trace.rttMs / 1000.0, 'f', 1) : QString("?"))
+                                 .arg(qRound(stats.stability * 100))
+                                 .arg(qRound(stats.asymmetry * 100)), 10000);
+    });
+    ui->node_table->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(ui->node_table, &QWidget::customContextMenuRequested, this, &MainApp::showNodeMenu);
+
+    connect(meshHandler, &meshtastic_handler::nodeInfoUpdate, nodeTable, &node_table_model::updateNodeInfo);
+    nodeSort = new node_sort_proxy(this);
+    nodeSort->setSourceModel(nodeTable);
+    ui->node_table->setModel(nodeSort);
+    ui->node_table->horizontalHeader()->setStretchLastSection(true);
+    ui->node_table->verticalHeader()->setVisible(false);
+    ui->node_table->sortByColumn(node_table_model::LastHeardColumn, Qt::DescendingOrder);
+
+    // Restore the last node checkpoint so the table and map are filled before the radio is connected
+    QElapsedTimer restoreTimer;
+    restoreTimer.start();
+    snapshotPath = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("meshmonitor_nodes.snap");
+    QVector<node_record> savedNodes = node_snapshot::load(snapshotPath);
+    nodeTable->restore(savedNodes);
+    for (const node_record& node : savedNodes) {
+        if (node.hasPosition()) {
+            onPositionUpdate(QString("!%1").arg(node.num, 8, 16, QChar('0')), node.latitude, node.longitude, node.lastHeardMs);
+        }
+    }
+    savedRevision = nodeTable->revision();
+    qDebug() << "[STARTUP] Restored" << savedNodes.size() << "nodes from snapshot in" << restoreTimer.elapsed() << "ms";
+
+    // Checkpoint the node table once a minute, only when something changed
+    snapshotTimer = new QTimer(this);
+    snapshotTimer->setInterval(60 * 1000);
+    connect(snapshotTimer, &QTimer::timeout, this, &MainApp::saveNodeSnapshot);
+    // Same tick ages out metric history, including nodes that have gone quiet
+    connect(snapshotTimer, &QTimer::timeout, this, [this]() {
+        nodeSeries.prune(QDateTime::currentMSecsSinceEpoch());
+    });
+    snapshotTimer->start();
+
+    // Utilization heatmap tab, coloured on its own thread from nodeSeries
+    QWidget* heatmapTab = new QWidget(this);
+    QVBoxLayout* heatmapLayout = new QVBoxLayout(heatmapTab);
+    QComboBox* heatmapMetric = new QComboBox(heatmapTab);
+    heatmapMetric->addItem("Channel utilization", int(node_series::ChannelUtilization));
+    heatmapMetric->addItem("Airtime (air_util_tx)", int(node_series::AirUtilTx));
+    heatmapView = new heatmap_view(heatmapTab);
+    heatmapLayout->addWidget(heatmapMetric);
+    heatmapLayout->addWidget(heatmapView, 1);
+    ui->tabWidget->addTab(heatmapTab, "Heatmap");
+
+    heatmapThread = new QThread(this);
+    heatmapRenderer = new heatmap_renderer(&nodeSeries);
+    heatmapRenderer->moveToThread(heatmapThread);
+    connect(heatmapThread, &QThread::started, heatmapRenderer, &heatmap_renderer::start);
+    connect(heatmapThread, &QThread::finished, heatmapRenderer, &QObject::deleteLater);
+    connect(heatmapRenderer, &heatmap_renderer::frameReady, heatmapView, &heatmap_view::setFrame);
+    connect(heatmapRenderer, &heatmap_renderer::rowsReady, heatmapView, &heatmap_view::addRows);
+    connect(heatmapRenderer, &heatmap_renderer::columnsReady, heatmapView, &heatmap_view::updateColumns);
+    connect(heatmapMetric, &QComboBox::currentIndexChanged, this, [this, heatmapMetric]() {
+        int column = heatmapMetric->currentData().toInt();
+        QMetaObject::invokeMethod(heatmapRenderer, [this, column]() { heatmapRenderer->setMetric(column); });
+    });
+    heatmapThread->start(QThread::LowPriority);
+
+    // Wait for typing to pause before running the query
+    filterTimer = new QTimer(this);
+    filterTimer->setSingleShot(true);
+    filterTimer->setInterval(200);
+    connect(filterTimer, &QTimer::timeout, this, &MainApp::applyFilter);
+    connect(ui->filter_edit, &QLineEdit::textChanged, filterTimer, qOverload<>(&QTimer::start));
+
     connect(ui->pushButton, &QPushButton::clicked, this, [this]() {
         qDebug() << "BUTTON CLICKED - Current text:" << ui->pushButton->text();
     });
 
+    // The map (and its Chromium renderer) is only created the first time the Map tab is opened,
+    // positions heard before then are kept in nodeCluster/nodeTrack and drawn once it loads
+    connect(ui->tabWidget, &QTabWidget::currentChanged, this, &MainApp::onTabChanged);
+    if (ui->tabWidget->currentWidget() == ui->Map) {
+        setupMap();
+    }
 
-    setupMap();
+    qDebug() << "[STARTUP] MainApp constructed in" << startupTimer.elapsed() << "ms";
 }
 
 MainApp::~MainApp()
 {
+    if (replayThread) {
+        replay->cancel();
+        replayThread->quit();
+        replayThread->wait();
+    }
+    if (exportThread) {
+        exporter->cancel();
+        exportThread->quit();
+        exportThread->wait();
+    }
+    QMetaObject::invokeMethod(heatmapRenderer, &heatmap_renderer::stop, Qt::BlockingQueuedConnection);
+    heatmapThread->quit();
+    heatmapThread->wait();
+    saveNodeSnapshot();
+    QMetaObject::invokeMethod(packetStore, &packet_store::close, Qt::BlockingQueuedConnection);
+    storeThread->quit();
+    storeThread->wait();
     delete ui;
 }
 
@@ -106,20 +356,72 @@ void MainApp::paintEvent(QPaintEvent *event)
     painter.drawPixmap(0, 0, scaledBackground);
 }
 
+void MainApp::onTabChanged(int index) {
+    if (!mapView && ui->tabWidget->widget(index) == ui->Map) {
+        setupMap();
+    }
+}
+
 void MainApp::setupMap() {
+    QElapsedTimer setupTimer;
+    setupTimer.start();
+    mapLoadTimer.start();
     mapView = new QWebEngineView(ui->Map);
 
-    // Wait for page to load before allowing map updates
-    connect(mapView, &QWebEngineView::loadFinished, [this](bool ok) {
+    // The page tells us itself when it is ready (see onMapPageReady), a load only resets state
+    connect(mapView, &QWebEngineView::loadStarted, this, [this]() {
+        mapReady = false;
+        hasViewport = false;
+        sentTracks.clear();
+    });
+    connect(mapView, &QWebEngineView::loadFinished, this, [this](bool ok) {
         qDebug() << "Map loaded successfully:" << ok;
-        mapReady = ok;
+        qDebug() << "[STARTUP] Map page loaded" << mapLoadTimer.elapsed() << "ms after the Map tab was opened";
+        if (!ok) {
+            qDebug() << "Failed to load map HTML";
+        }
+    });
+
+    // Tiles and Leaflet itself come from the local cache so the map works offline
+    tileCache = new tile_cache(this);
+    if (!tileCache->initDatabase()) {
+        qDebug() << "Tile cache unavailable, tiles will be fetched but not kept";
+    }
+    mapView->page()->profile()->installUrlSchemeHandler(tile_cache::SCHEME, tileCache);
+    connect(tileCache, &tile_cache::prefetchProgress, this, [this](int done, int total) {
+        statusBar()->showMessage(QString("Downloading offline map: %1 / %2 tiles").arg(done).arg(total));
+    });
+    connect(tileCache, &tile_cache::prefetchFinished, this, [this](int fetched, int failed) {
+        statusBar()->showMessage(QString("Offline map ready: %1 tiles saved, %2 failed").arg(fetched).arg(failed), 10000);
+    });
+
+    // The page reports its viewport back over the web channel so only
+    // clusters and nodes that are on screen get sent to it
+    mapBridge = new map_bridge(this);
+    connect(mapBridge, &map_bridge::pageReady, this, &MainApp::onMapPageReady);
+    connect(mapBridge, &map_bridge::viewportReported, this, &MainApp::onViewportReported);
+    connect(mapBridge, &map_bridge::prefetchRequested, this,
+            [this](double south, double west, double north, double east, int minZoom, int maxZoom) {
+        if (!tileCache->prefetch(south, west, north, east, minZoom, maxZoom)) {
+            statusBar()->showMessage("Offline map area too large, zoom in and try again", 10000);
+        }
     });
+    mapChannel = new QWebChannel(this);
+    mapChannel->registerObject(QStringLiteral("bridge"), mapBridge);
+    mapView->page()->setWebChannel(mapChannel);
+
+    // Coalesce bursts of position updates into one render
+    mapRenderTimer = new QTimer(this);
+    mapRenderTimer->setSingleShot(true);
+    mapRenderTimer->setInterval(100);
+    connect(mapRenderTimer, &QTimer::timeout, this, &MainApp::renderMap);
 
     QVBoxLayout* mapLayout = new QVBoxLayout(ui->Map);
     mapLayout->addWidget(mapView);
     mapLayout->setContentsMargins(0, 0, 0, 0);
 
     mapView->load(QUrl("qrc:/map.html"));
+    qDebug() << "[STARTUP] Map view created in" << setupTimer.elapsed() << "ms";
 }
 
 void MainApp::on_pushButton_clicked()
@@ -135,90 +437,251 @@ void MainApp::on_pushButton_clicked()
     }
 }
 
-void MainApp::onMapLoadFinished(bool success) {
-    if (success) {
-        qDebug() << "Map loaded, injecting addNode function...";
+void MainApp::saveNodeSnapshot() {
+    if (nodeTable->revision() == savedRevision) {
+        return;
+    }
+    if (node_snapshot::save(snapshotPath, nodeTable->records())) {
+        savedRevision = nodeTable->revision();
+    }
+}
 
-        // Inject the addNode function directly
-        QString addNodeFunction = R"(
-            var nodeMarkers = {};
+void MainApp::showNodeMenu(const QPoint& pos) {
+    QModelIndex index = nodeSort->mapToSource(ui->node_table->indexAt(pos));
+    if (!index.isValid()) {
+        return;
+    }
+    quint32 num = nodeTable->record(index.row()).num;
+
+    QMenu menu(this);
+    // Sending packets needs the protobuf API, which the user has to opt into, see startApiSession
+    bool api = meshHandler->apiSessionActive();
+    QAction* startApi = nullptr;
+    if (!api) {
+        startApi = menu.addAction("Start API session for traceroutes...");
+        startApi->setEnabled(meshHandler->isRunning());
+    }
+    QAction* traceNow = menu.addAction("Trace route now");
+    traceNow->setEnabled(api);
+    QAction* watch = menu.addAction("Trace route periodically");
+    watch->setCheckable(true);
+    watch->setChecked(traceroutes->isWatched(num));
+    watch->setEnabled(api);
+    QAction* route = menu.addAction("Show route");
+    double lat, lon;
+    QAction* nearby = menu.addAction("Nearest nodes");
+    nearby->setEnabled(spatialIndex.position(num, lat, lon));
+    QAction* chosen = menu.exec(ui->node_table->viewport()->mapToGlobal(pos));
+    if (chosen == nearby) {
+        QStringList names;
+        // The node itself comes back first at distance 0
+        for (const node_spatial_index::Hit& hit : spatialIndex.nearest(lat, lon, 6)) {
+            if (hit.node != num) {
+                names.append(QString("!%1 %2 km").arg(hit.node, 8, 16, QChar('0')).arg(hit.distanceKm, 0, 'f', 1));
+            }
+        }
+        statusBar()->showMessage(names.isEmpty() ? QString("No other nodes with a position")
+                                                 : "Nearest: " + names.join(", "), 15000);
+    } else if (chosen == route) {
+        QStringList hops;
+        for (quint32 hop : topology.shortestPath(topology.localNode(), num, QDateTime::currentMSecsSinceEpoch())) {
+            hops.append(hop == topology_graph::LOCAL ? QString("local") : QString("!%1").arg(hop, 8, 16, QChar('0')));
+        }
+        statusBar()->showMessage(hops.isEmpty() ? QString("No known path to this node")
+                                                : "Route: " + hops.join(" -> "), 15000);
+    } else if (chosen && chosen == startApi) {
+        QMessageBox::StandardButton answer = QMessageBox::question(this, "Start API session",
+            "Traceroutes can only be sent through the radio's protobuf API. Once it starts, the firmware "
+            "stops printing its plain text log and only sends it as log records if "
+            "security.debug_log_api_enabled is set on the node. Without that setting the packet, position, "
+            "telemetry and battery views stop updating until the radio is reconnected.\n\nStart it anyway?");
+        if (answer == QMessageBox::Yes && meshHandler->startApiSession()) {
+            statusBar()->showMessage("API session started, traceroutes are available", 10000);
+        }
+    } else if (chosen == traceNow) {
+        traceroutes->traceNow(num);
+    } else if (chosen == watch) {
+        traceroutes->setWatched(num, watch->isChecked());
+    }
+}
 
-            function addNode(nodeId, lat, lon, isNewNode) {
-                console.log('Adding node:', nodeId, 'at', lat, lon);
+void MainApp::refreshTopology() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QVector<quint32> cuts = topology.articulationPoints(now);
+    QSet<quint32> critical(cuts.cbegin(), cuts.cend());
+    // Every path comes out of the one cached tree rooted at our radio
+    quint32 local = topology.localNode();
+    for (const node_record& node : nodeTable->records()) {
+        nodeTable->updatePath(node.num, topology.shortestPath(local, node.num, now), critical.contains(node.num));
+    }
+}
 
-                if (nodeMarkers[nodeId]) {
-                    map.removeLayer(nodeMarkers[nodeId]);
-                }
+void MainApp::onBatterySample(quint32 node, const battery_estimate& battery) {
+    nodeTable->updateBattery(node, battery);
+    if (!battery.alert) {
+        return;
+    }
+    QString message = QString("Battery on %1 draining %2%/h, usually %3%/h")
+                          .arg(node == 0 ? QString("the local node") : QString("!%1").arg(node, 8, 16, QChar('0')))
+                          .arg(std::isnan(battery.recentDrainPerHour) ? battery.drainPerHour : battery.recentDrainPerHour, 0, 'f', 1)
+                          .arg(battery.baselinePerHour, 0, 'f', 1);
+    if (!std::isnan(battery.hoursToEmpty)) {
+        message += QString(", about %1 h left").arg(battery.hoursToEmpty, 0, 'f', 1);
+    }
+    qDebug() << "[BATTERY]" << message;
+    statusBar()->showMessage(message, 30000);
+}
 
-                var marker = L.marker([lat, lon]).addTo(map);
+void MainApp::onPositionUpdate(const QString& nodeId, double lat, double lon, qint64 timestampMs) {
+    qDebug() << "MainApp received position update for" << nodeId << "at" << lat << "," << lon;
+    bool ok;
+    quint32 num = nodeId.mid(1).toUInt(&ok, 16);
+    if (ok) {
+        spatialIndex.update(num, lat, lon);
+        rangeBearing.update(num, lat, lon);
+        float distanceKm, bearingDeg;
+        if (rangeBearing.lookup(num, distanceKm, bearingDeg)) {
+            nodeTable->updateRange(num, distanceKm, bearingDeg);
+        }
+    }
+    bool trackChanged = nodeTrack.addPoint(nodeId, lat, lon, timestampMs);
+    updateNodeOnMap(nodeId, lat, lon, trackChanged);
+}
 
-                var popupContent = '<b>Node: ' + nodeId + '</b><br>' +
-                                  'Latitude: ' + lat.toFixed(6) + '<br>' +
-                                  'Longitude: ' + lon.toFixed(6) + '<br>' +
-                                  'Last Update: ' + new Date().toLocaleString();
+// Our own fix moved: every node's range and bearing is recomputed in one batch
+void MainApp::onLocalPosition(double lat, double lon) {
+    QElapsedTimer timer;
+    timer.start();
+    rangeBearing.setOrigin(lat, lon);
+    qint64 computeUs = timer.nsecsElapsed() / 1000;
+
+    float distanceKm, bearingDeg;
+    for (quint32 num : rangeBearing.nodeList()) {
+        if (rangeBearing.lookup(num, distanceKm, bearingDeg)) {
+            nodeTable->updateRange(num, distanceKm, bearingDeg);
+        }
+    }
+    DEBUG_MAP("Recomputed range for" << rangeBearing.size() << "nodes in" << computeUs << "us");
+}
 
-                marker.bindPopup(popupContent);
-                nodeMarkers[nodeId] = marker;
+void MainApp::updateNodeOnMap(const QString& nodeId, double lat, double lon, bool trackChanged) {
+    // Remember where the node was drawn before its first queued update so a
+    // node leaving the screen still triggers a redraw
+    auto pending = pendingNodes.find(nodeId);
+    if (pending == pendingNodes.end()) {
+        PendingNode entry;
+        entry.known = nodeCluster.position(nodeId, entry.oldLat, entry.oldLon);
+        pending = pendingNodes.insert(nodeId, entry);
+    }
+    pending->trackChanged = pending->trackChanged || trackChanged;
+    nodeCluster.updateNode(nodeId, lat, lon);
 
-                if (isNewNode || Object.keys(nodeMarkers).length === 1) {
-                    map.setView([lat, lon], 12);
-                }
+    if (!mapReady || !hasViewport) {
+        DEBUG_MAP("Map not ready yet, queued update for node:" << nodeId);
+        return;
+    }
+    flushPendingNodes();
+}
 
-                return true;
-            }
+// Returns true if the map was recentred, the page then reports a new viewport by itself
+bool MainApp::flushPendingNodes() {
+    if (!mapReady || !hasViewport || pendingNodes.isEmpty()) {
+        return false;
+    }
 
-            window.mapReady = true;
-            console.log('addNode function injected and map ready');
-        )";
+    QHash<QString, PendingNode> pending;
+    pending.swap(pendingNodes);
+
+    // Center on the first node we hear about
+    if (!mapCentered) {
+        mapCentered = true;
+        double lat, lon;
+        if (nodeCluster.position(pending.constBegin().key(), lat, lon)) {
+            mapView->page()->runJavaScript(QString("centerMap(%1, %2, 12);")
+                                               .arg(lat, 0, 'f', 6)
+                                               .arg(lon, 0, 'f', 6));
+            return true;
+        }
+    }
 
-        mapView->page()->runJavaScript(addNodeFunction, [this](const QVariant &result) {
-            QTimer::singleShot(500, [this]() {
-                checkMapReady();
-            });
-        });
-    } else {
-        qDebug() << "Failed to load map HTML";
+    // Nodes moving around off screen don't need a redraw
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        double lat, lon;
+        if ((nodeCluster.position(it.key(), lat, lon) && node_cluster::inViewport(mapViewport, lat, lon)) ||
+            (it->known && node_cluster::inViewport(mapViewport, it->oldLat, it->oldLon)) ||
+            (it->trackChanged && sentTracks.contains(it.key()))) {
+            scheduleMapRender();
+            break;
+        }
     }
+    return false;
 }
 
-void MainApp::onPositionUpdate(const QString& nodeId, double lat, double lon) {
-    qDebug() << "MainApp received position update for" << nodeId << "at" << lat << "," << lon;
-    updateNodeOnMap(nodeId, lat, lon);
+void MainApp::scheduleMapRender() {
+    if (mapRenderTimer && !mapRenderTimer->isActive()) {
+        mapRenderTimer->start();
+    }
 }
 
-void MainApp::updateNodeOnMap(const QString& nodeId, double lat, double lon) {
-    if (!mapReady) {
-        qDebug() << "Map not ready yet, skipping update for node:" << nodeId;
+void MainApp::renderMap() {
+    if (!mapReady || !hasViewport) {
         return;
     }
 
-    QString jsCode = QString("addNode('%1', %2, %3, false);")
-                         .arg(nodeId)
-                         .arg(lat, 0, 'f', 6)
-                         .arg(lon, 0, 'f', 6);
-
-    qDebug() << "Executing JS:" << jsCode;
-    mapView->page()->runJavaScript(jsCode, [nodeId](const QVariant &result) {
-        if (result.toBool()) {
-            qDebug() << "Successfully added/updated node:" << nodeId;
-        } else {
-            qDebug() << "Failed to add/update node:" << nodeId;
+    QVector<node_cluster::Item> items = nodeCluster.query(mapViewport);
+    QHash<QString, QPair<quint64, int>> stillSent;
+    QJsonArray itemArray;
+    for (const node_cluster::Item& item : items) {
+        QJsonObject obj;
+        obj["key"] = item.key;
+        obj["lat"] = item.lat;
+        obj["lon"] = item.lon;
+        obj["count"] = item.count;
+        if (item.count == 1) {
+            obj["id"] = item.nodeId;
+
+            // Only resend a track when it changed or the zoom level (and so its detail) did
+            if (nodeTrack.pointCount(item.nodeId) > 1) {
+                QPair<quint64, int> sent = qMakePair(nodeTrack.version(item.nodeId), mapViewport.zoom);
+                if (sentTracks.value(item.nodeId) != sent) {
+                    QJsonArray track;
+                    for (const node_track::TrackPoint& point : nodeTrack.simplified(item.nodeId, mapViewport.zoom)) {
+                        track.append(QJsonArray{point.lat, point.lon});
+                    }
+                    obj["track"] = track;
+                }
+                stillSent.insert(item.nodeId, sent);
+            }
         }
-    });
+        itemArray.append(obj);
+    }
+    sentTracks = stillSent;
+
+    QString jsCode = QString("renderMapItems(%1);")
+                         .arg(QString::fromUtf8(QJsonDocument(itemArray).toJson(QJsonDocument::Compact)));
+    DEBUG_MAP("Rendering" << items.size() << "map items out of" << nodeCluster.size() << "nodes");
+    mapView->page()->runJavaScript(jsCode);
 }
 
-void MainApp::checkMapReady() {
-    mapView->page()->runJavaScript("window.mapReady", [this](const QVariant &result) {
-        if (result.toBool()) {
-            mapReady = true;
-            qDebug() << "Map is ready for updates";
-        } else {
-            qDebug() << "Map not yet ready, checking again...";
-            QTimer::singleShot(1000, [this]() {
-                checkMapReady();
-            });
-        }
-    });
+void MainApp::onMapPageReady() {
+    qDebug() << "Map is ready for updates," << pendingNodes.size() << "queued nodes";
+    mapReady = true;
+}
+
+void MainApp::onViewportReported(double south, double west, double north, double east, int zoom) {
+    mapViewport.south = south;
+    mapViewport.west = west;
+    mapViewport.north = north;
+    mapViewport.east = east;
+    mapViewport.zoom = zoom;
+    hasViewport = true;
+
+    if (flushPendingNodes()) {
+        return;
+    }
+    // The whole viewport changed, redraw now rather than waiting for the timer
+    mapRenderTimer->stop();
+    renderMap();
 }
 
 //Turn full packet debug on or off
@@ -252,6 +715,29 @@ void MainApp::onConnectionStateChanged(meshtastic_handler::Connection_Status sta
     }
 }
 
+void MainApp::applyFilter() {
+    QString error;
+    event_filter filter = event_filter::parse(ui->filter_edit->text().trimmed(), &error);
+    if (!error.isEmpty()) {
+        statusBar()->showMessage(error, 5000);
+    }
+
+    QElapsedTimer queryTimer;
+    queryTimer.start();
+    filterModel->setFilter(filter);
+
+    // The live log is shown again once the filter is cleared
+    bool filtering = !filter.isEmpty();
+    ui->filter_view->setVisible(filtering);
+    ui->packet_view->setVisible(!filtering);
+    if (filtering) {
+        statusBar()->showMessage(QString("%1 of %2 events match (%3 ms)")
+                                     .arg(filterModel->rowCount())
+                                     .arg(eventStore->size())
+                                     .arg(queryTimer.elapsed()), 5000);
+    }
+}
+
 void MainApp::on_debug_check_clicked(bool checked)
 {
    meshHandler->set_debug_status(checked);
@@ -263,20 +749,153 @@ void MainApp::on_clear_terminal_button_clicked()
 }
 
 void MainApp::on_saveButton_clicked() {
-    QString log = ui->packet_view->toPlainText();
-    QString fileName = QFileDialog::getSaveFileName(this, tr("Save File"), "", tr("Text Files (*.txt);;All Files (*)"));
+    if (exportThread) {
+        return;
+    }
 
+    QString selectedFilter;
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save File"), "",
+                                                    tr("Event lines (*.txt);;NDJSON (*.ndjson);;CSV (*.csv);;"
+                                                       "Stored history as NDJSON (*.ndjson);;Stored history as CSV (*.csv);;"
+                                                       "Node table as CSV (*.csv);;All Files (*)"),
+                                                    &selectedFilter);
     if (fileName.isEmpty()) {
         return;
     }
-    QFile file(fileName);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        out << log;
-        file.close();
+
+    // One row per node, small enough to write right here
+    if (selectedFilter.startsWith("Node table")) {
+        if (exportNodeTable(fileName)) {
+            QMessageBox::information(this, tr("Success"), tr("File saved successfully!"));
+        } else {
+            QMessageBox::critical(this, tr("Error"), tr("Could not save file!"));
+        }
+        return;
+    }
+
+    // The export streams from the event store on its own thread so a long history
+    // doesn't freeze the UI or get copied into memory first
+    event_exporter::Format format = event_exporter::formatForFilter(selectedFilter.isEmpty() ? fileName : selectedFilter);
+    exportThread = new QThread(this);
+    if (selectedFilter.startsWith("Stored history")) {
+        // Everything in the packet database, paged on the export thread
+        packet_range range;
+        range.toMs = QDateTime::currentMSecsSinceEpoch();
+        exporter = new event_exporter(std::make_unique<packet_query>(packetDbPath, range), fileName, format);
+    } else {
+        exporter = new event_exporter(eventStore, fileName, format);
+    }
+    exporter->moveToThread(exportThread);
+
+    exportProgress = new QProgressDialog(tr("Exporting events..."), tr("Cancel"), 0, 100, this);
+    exportProgress->setWindowModality(Qt::WindowModal);
+    exportProgress->setMinimumDuration(500);
+    exportProgress->setAutoClose(false);
+    exportProgress->setAutoReset(false);
+
+    connect(exportThread, &QThread::started, exporter, &event_exporter::run);
+    connect(exportThread, &QThread::finished, exporter, &QObject::deleteLater);
+    connect(exporter, &event_exporter::progress, exportProgress, &QProgressDialog::setValue);
+    connect(exporter, &event_exporter::finished, this, &MainApp::onExportFinished);
+    // run() never returns to the event loop until it is done, so cancel through the atomic flag
+    connect(exportProgress, &QProgressDialog::canceled, this, [this]() {
+        if (exporter) {
+            exporter->cancel();
+        }
+    });
+
+    exportThread->start();
+}
+
+bool MainApp::exportNodeTable(const QString& fileName) {
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    auto number = [](double value, int precision) {
+        return std::isnan(value) ? QByteArray() : QByteArray::number(value, 'f', precision);
+    };
+    auto stats = [&number](const link_stats& link) {
+        return number(link.ewma, 2) + ',' + number(link.min, 2) + ',' + number(link.max, 2) + ',' +
+               number(link.p10, 2) + ',' + number(link.p50, 2) + ',' + number(link.p90, 2);
+    };
+    auto quoted = [](const QString& text) {
+        QByteArray utf8 = text.toUtf8();
+        utf8.replace('"', "\"\"");
+        return '"' + utf8 + '"';
+    };
+
+    QByteArray out = "id,short_name,long_name,last_heard_ms,hops,battery_level,voltage,latitude,longitude,"
+                     "snr_ewma,snr_min,snr_max,snr_p10,snr_p50,snr_p90,"
+                     "rssi_ewma,rssi_min,rssi_max,rssi_p10,rssi_p50,rssi_p90,link_samples,"
+                     "airtime_tx_estimated,air_util_tx,channel_util_estimated,channel_utilization,"
+                     "distance_km,bearing_deg,drain_per_hour,hours_to_empty\n";
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const node_record& node : nodeTable->records()) {
+        link_summary link = linkQuality.summary(node.num, now);
+        out += QString("!%1").arg(node.num, 8, 16, QChar('0')).toUtf8() + ',';
+        out += quoted(node.shortName) + ',' + quoted(node.longName) + ',';
+        out += QByteArray::number(node.lastHeardMs) + ',';
+        out += (node.hops < 0 ? QByteArray() : QByteArray::number(node.hops)) + ',';
+        out += (node.batteryLevel < 0 ? QByteArray() : QByteArray::number(node.batteryLevel)) + ',';
+        out += number(node.voltage, 3) + ',' + number(node.latitude, 7) + ',' + number(node.longitude, 7) + ',';
+        out += stats(link.snr) + ',' + stats(link.rssi) + ',';
+        airtime_check air = airtime.check(node.num, now);
+        out += QByteArray::number(link.snr.samples) + ',';
+        out += number(air.estimatedTxPercent, 2) + ',' + number(air.reportedTxPercent, 2) + ',';
+        out += number(air.estimatedChannelPercent, 2) + ',' + number(air.reportedChannelPercent, 2) + ',';
+        out += number(node.distanceKm, 3) + ',' + number(node.bearingDeg, 1) + ',';
+        out += number(node.drainPerHour, 2) + ',' + number(node.hoursToEmpty, 1) + '\n';
+    }
+    file.write(out);
+    return file.commit();
+}
+
+void MainApp::recordEvent(const mesh_event& event) {
+    if (replayThread) {
+        pendingReplay.append(event);
+        return;
+    }
+    eventStore->append(event);
+    nodeSeries.append(event);
+    eventLog.append(event);
+}
+
+void MainApp::onReplayFinished(bool opened, int replayed, qint64 elapsedMs) {
+    replayThread->quit();
+    replayThread->wait();
+    replayThread->deleteLater();
+    replayThread = nullptr;
+    replay = nullptr;
+    if (opened) {
+        qDebug() << "[STARTUP] Replayed" << replayed << "events from the event log in" << elapsedMs << "ms";
+    }
+
+    // The log is back on this thread, catch up with what arrived meanwhile
+    QVector<mesh_event> pending;
+    pending.swap(pendingReplay);
+    eventStore->appendBatch(pending);
+    nodeSeries.appendBatch(pending);
+    for (const mesh_event& event : pending) {
+        eventLog.append(event);
+    }
+}
+
+void MainApp::onExportFinished(bool ok, const QString& error, qint64 exported) {
+    exportThread->quit();
+    exportThread->wait();
+    exportThread->deleteLater();
+    exportThread = nullptr;
+    exporter = nullptr;
+    exportProgress->deleteLater();
+    exportProgress = nullptr;
+
+    if (ok) {
+        statusBar()->showMessage(tr("Exported %1 events").arg(exported), 5000);
         QMessageBox::information(this, tr("Success"), tr("File saved successfully!"));
     } else {
-        QMessageBox::critical(this, tr("Error"), tr("Could not open file!."));
+        QMessageBox::critical(this, tr("Error"), tr("Could not save file: %1").arg(error));
     }
 }
 
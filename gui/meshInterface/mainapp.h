@@ -2,10 +2,39 @@
 #define MAINAPP_H
 
 #include "meshtastic_handler.h"
+#include "node_cluster.h"
+#include "node_track.h"
+#include "map_bridge.h"
+#include "tile_cache.h"
+#include "event_store.h"
+#include "event_filter_model.h"
+#include "node_table_model.h"
+#include "node_sort_proxy.h"
+#include "event_exporter.h"
+#include "log_sink.h"
+#include "packet_store.h"
+#include "node_series.h"
+#include "event_log.h"
+#include "event_replay.h"
+#include "node_snapshot.h"
+#include "duplicate_filter.h"
+#include "link_quality.h"
+#include "topology_graph.h"
+#include "traceroute_tracker.h"
+#include "airtime_accounting.h"
+#include "heatmap_renderer.h"
+#include "heatmap_view.h"
+#include "node_spatial_index.h"
+#include "range_bearing.h"
+#include "battery_trend.h"
 #include <QMainWindow>
 #include <QPaintEvent>
 #include <QResizeEvent>
 #include <QWebEngineView>
+#include <QWebChannel>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QProgressDialog>
 
 
 QT_BEGIN_NAMESPACE
@@ -31,10 +60,75 @@ private:
     void createGpsInfoWidget();
     QWebEngineView* mapView;
     void setupMap();
+    QElapsedTimer mapLoadTimer;
     bool mapReady = false;
-    void updateNodeOnMap(const QString& nodeId, double lat, double lon);
-    void checkMapReady();
-    void onPositionUpdate(const QString& nodeId, double lat, double lon);
+    void updateNodeOnMap(const QString& nodeId, double lat, double lon, bool trackChanged = false);
+    void onPositionUpdate(const QString& nodeId, double lat, double lon, qint64 timestampMs);
+    node_cluster nodeCluster;
+    node_track nodeTrack;
+    QHash<QString, QPair<quint64, int>> sentTracks;
+
+    // Nodes updated since the last flush, the latest position lives in nodeCluster
+    struct PendingNode {
+        bool known = false;
+        double oldLat = 0.0;
+        double oldLon = 0.0;
+        bool trackChanged = false;
+    };
+    QHash<QString, PendingNode> pendingNodes;
+    bool flushPendingNodes();
+    duplicate_filter* duplicateFilter;
+    event_store* eventStore;
+    log_sink* logSink;
+    QThread* storeThread;
+    packet_store* packetStore;
+    QString packetDbPath;
+    node_series nodeSeries;
+    event_log eventLog;
+    QThread* replayThread = nullptr;
+    event_replay* replay = nullptr;
+    // Accepted events wait here while the replay owns the log, so they land after the history
+    QVector<mesh_event> pendingReplay;
+    void recordEvent(const mesh_event& event);
+    void onReplayFinished(bool opened, int replayed, qint64 elapsedMs);
+    event_filter_model* filterModel;
+    QTimer* filterTimer;
+    void applyFilter();
+    node_table_model* nodeTable;
+    node_sort_proxy* nodeSort;
+    link_quality linkQuality;
+    topology_graph topology;
+    QTimer* topologyTimer;
+    void refreshTopology();
+    traceroute_tracker* traceroutes;
+    airtime_accounting airtime;
+    QThread* heatmapThread;
+    heatmap_renderer* heatmapRenderer;
+    heatmap_view* heatmapView;
+    node_spatial_index spatialIndex;
+    range_bearing rangeBearing;
+    void onLocalPosition(double lat, double lon);
+    battery_trend batteryTrend;
+    void onBatterySample(quint32 node, const battery_estimate& battery);
+    void showNodeMenu(const QPoint& pos);
+    bool exportNodeTable(const QString& fileName);
+    QString snapshotPath;
+    QTimer* snapshotTimer;
+    quint64 savedRevision = 0;
+    void saveNodeSnapshot();
+    QThread* exportThread;
+    event_exporter* exporter;
+    QProgressDialog* exportProgress;
+    void onExportFinished(bool ok, const QString& error, qint64 exported);
+    map_bridge* mapBridge;
+    QWebChannel* mapChannel;
+    tile_cache* tileCache;
+    node_cluster::Viewport mapViewport;
+    bool hasViewport = false;
+    bool mapCentered = false;
+    QTimer* mapRenderTimer;
+    void scheduleMapRender();
+    void renderMap();
     //void moveBackground();
 
 signals:
@@ -44,8 +138,10 @@ private slots:
     void onConnectionStateChanged(meshtastic_handler::Connection_Status status);
     void on_debug_check_clicked(bool checked);
     void on_clear_terminal_button_clicked();
-    void onMapLoadFinished(bool success);
     void on_saveButton_clicked();
+    void onMapPageReady();
+    void onViewportReported(double south, double west, double north, double east, int zoom);
+    void onTabChanged(int index);
 };
 
 #endif // MAINAPP_H
@@ -0,0 +1,38 @@
+#include "map_bridge.h"
+#include "debug_config.h"
+#include <cmath>
+
+map_bridge::map_bridge(QObject *parent)
+    : QObject{parent}
+{
+}
+
+void map_bridge::mapReady() {
+    DEBUG_MAP("Map page reported ready");
+    emit pageReady();
+}
+
+// Leaflet reports unwrapped longitudes once the map has been panned over the antimeridian
+// (170..190, or -190..-170). Everything behind the bridge takes west in [-180, 180), east in
+// (-180, 180] and west > east for a box that crosses 180°
+void map_bridge::wrapLongitudes(double& west, double& east) {
+    if (east - west >= 360.0) {
+        west = -180.0;
+        east = 180.0;
+        return;
+    }
+    west -= 360.0 * std::floor((west + 180.0) / 360.0);
+    east -= 360.0 * std::ceil((east - 180.0) / 360.0);
+}
+
+void map_bridge::viewportChanged(double south, double west, double north, double east, int zoom) {
+    wrapLongitudes(west, east);
+    DEBUG_MAP("Viewport changed - S:" << south << "W:" << west << "N:" << north << "E:" << east << "Zoom:" << zoom);
+    emit viewportReported(south, west, north, east, zoom);
+}
+
+void map_bridge::prefetchArea(double south, double west, double north, double east, int minZoom, int maxZoom) {
+    wrapLongitudes(west, east);
+    DEBUG_MAP("Offline area requested - zoom" << minZoom << "to" << maxZoom);
+    emit prefetchRequested(south, west, north, east, minZoom, maxZoom);
+}
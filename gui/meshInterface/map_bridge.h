@@ -0,0 +1,28 @@
+#ifndef MAP_BRIDGE_H
+#define MAP_BRIDGE_H
+
+#include <QObject>
+
+// Object published to map.html over QWebChannel so the page can report
+// back to C++ (readiness, viewport changes after a pan or zoom, offline area requests)
+class map_bridge : public QObject
+{
+    Q_OBJECT
+public:
+    explicit map_bridge(QObject *parent = nullptr);
+
+public slots:
+    void mapReady();
+    void viewportChanged(double south, double west, double north, double east, int zoom);
+    void prefetchArea(double south, double west, double north, double east, int minZoom, int maxZoom);
+
+signals:
+    void pageReady();
+    void viewportReported(double south, double west, double north, double east, int zoom);
+    void prefetchRequested(double south, double west, double north, double east, int minZoom, int maxZoom);
+
+private:
+    static void wrapLongitudes(double& west, double& east);
+};
+
+#endif // MAP_BRIDGE_H
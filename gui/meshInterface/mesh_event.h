@@ -0,0 +1,60 @@
+#ifndef MESH_EVENT_H
+#define MESH_EVENT_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QtGlobal>
+#include <QString>
+#include <cmath>
+
+// Typed form of everything the handler reports (packets, text, positions, telemetry).
+// The JSON that is shown in the packet log is kept alongside the fields that are
+// searched and aggregated so nothing has to be re-parsed later.
+struct mesh_event
+{
+    enum Kind {
+        Packet,
+        Text,
+        Position,
+        Telemetry,
+        Info
+    };
+
+    qint64 timestampMs = 0;
+    Kind kind = Info;
+    quint32 from = 0;
+    quint32 to = 0;
+    quint32 packetId = 0;
+    int portnum = -1;
+    int channel = -1;
+    float rxSnr = NAN;
+    int rxRssi = 0;
+    int hopLimit = -1;
+    int hopStart = -1;
+    // Firmware only reports the last byte of the relaying node's number
+    int relayNode = -1;
+    // Decoded payload size when the firmware printed it
+    int payloadLength = -1;
+    int batteryLevel = -1;
+    float voltage = NAN;
+    float airUtilTx = NAN;
+    float channelUtilization = NAN;
+    double latitude = NAN;
+    double longitude = NAN;
+    int altitude = 0;
+    // From our own position to the sender's last known one, filled in before the event is distributed
+    float distanceKm = NAN;
+    float bearingDeg = NAN;
+    QString level;
+    QString text;
+    QByteArray json;
+
+    int hopsAway() const { return hopStart >= 0 && hopLimit >= 0 ? qMax(0, hopStart - hopLimit) : -1; }
+    bool hasSnr() const { return !std::isnan(rxSnr); }
+    bool hasPosition() const { return !std::isnan(latitude) && !std::isnan(longitude); }
+    QString fromId() const { return QString("!%1").arg(from, 8, 16, QChar('0')); }
+};
+
+Q_DECLARE_METATYPE(mesh_event)
+
+#endif // MESH_EVENT_H
@@ -1,8 +1,11 @@
 #include "meshtastic_handler.h"
 #include "debug_config.h"
+#include "lora_airtime.h"
 #include <QFile>
 #include <QEventLoop>
 #include <QTimer>
+#include <QHash>
+#include <QRandomGenerator>
 
 meshtastic_handler::meshtastic_handler(QObject* parent)
     : QObject(parent), currentState(Disconnected), msgCount(0), debug_status(false)
@@ -11,6 +14,14 @@ meshtastic_handler::meshtastic_handler(QObject* parent)
     connect(serialPort, &QSerialPort::readyRead, this, &meshtastic_handler::onSerialDataReady);
     connect(serialPort, QOverload<QSerialPort::SerialPortError>::of(&QSerialPort::errorOccurred),
             this, &meshtastic_handler::onSerialError);
+    // The firmware drops an API client it hasn't heard from in a while
+    heartbeatTimer = new QTimer(this);
+    heartbeatTimer->setInterval(HEARTBEAT_MS);
+    connect(heartbeatTimer, &QTimer::timeout, this, [this]() {
+        meshtastic::ToRadio heartbeat;
+        heartbeat.mutable_heartbeat();
+        writeToRadio(heartbeat);
+    });
     DEBUG_MESH("meshtastic_handler constructor completed");
 }
 
@@ -111,6 +122,11 @@ void meshtastic_handler::stopMeshtastic()
     DEBUG_CONNECTION("stopMeshtastic() called");
     DEBUG_CONNECTION("Serial port exists:" << (serialPort != nullptr));
 
+    heartbeatTimer->stop();
+    if (apiSession) {
+        apiSession = false;
+        emit apiSessionChanged(false);
+    }
     if (serialPort && serialPort->isOpen()) {
         DEBUG_CONNECTION("Serial port is open, closing connection");
         DEBUG_CONNECTION("Port name before close:" << serialPort->portName());
@@ -223,10 +239,17 @@ void meshtastic_handler::processData(const QByteArray& data) {
             QByteArray packetData = dataBuffer.mid(4, packetLength);
             dataBuffer.remove(0, packetLength + 4); // Remove processed data
 
-            meshtastic::MeshPacket packet;
-            if (packet.ParseFromArray(packetData.constData(), packetData.size())) {
+            // Everything the radio frames is a FromRadio, mesh traffic is its packet variant
+            meshtastic::FromRadio fromRadio;
+            if (fromRadio.ParseFromArray(packetData.constData(), packetData.size())) {
                 DEBUG_PACKET("Successfully parsed Protobuf packet!");
-                // processProtobufPacket(packet);
+                if (fromRadio.has_packet()) {
+                    processProtobufPacket(fromRadio.packet());
+                } else if (fromRadio.has_my_info()) {
+                    setLocalNode(fromRadio.my_info().my_node_num());
+                } else if (fromRadio.has_log_record()) {
+                    processLine(QString::fromStdString(fromRadio.log_record().message()));
+                }
                 msgCount++;
                 DEBUG_PACKET("Message count incremented to:" << msgCount);
             } else {
@@ -252,46 +275,190 @@ void meshtastic_handler::processData(const QByteArray& data) {
             QString logLine = QString::fromUtf8(logData);
             QRegularExpression ansiRegex("\x1B\\[[0-9;]*m");
             logLine.remove(ansiRegex);
+            processLine(logLine);
+        }
+    }
+}
 
-            //grab battery information
-            //This will be added to a "Server" node view after a check to see if it is different then the prev value made it has to do this
-            //a few times to avoid constantly updating values.
-            if (logLine.contains("Battery")) {
-                parseBatteryData(logLine);
-            }
+// Firmware log lines, read as plain text or unwrapped from LogRecords in an API session
+void meshtastic_handler::processLine(const QString& logLine) {
+    //grab battery information
+    //This will be added to a "Server" node view after a check to see if it is different then the prev value made it has to do this
+    //a few times to avoid constantly updating values.
+    if (logLine.contains("Battery")) {
+        parseBatteryData(logLine);
+    }
 
-            if (logLine.contains("Received from")) {
-                parseSenderData(logLine);
-            }
+    if (logLine.contains("Received from")) {
+        parseSenderData(logLine);
+    }
 
-            if (logLine.contains("handleReceived")) {
-                parseHandleReceivedData(logLine);
-            }
+    if (logLine.contains("Enqueued local")) {
+        parseEnqueuedLocal(logLine);
+    }
 
-            if (logLine.contains("Received text msg")) {
-                parseTextData(logLine);
-            }
+    if (logLine.contains("handleReceived")) {
+        parseHandleReceivedData(logLine);
+    }
 
-            if (logLine.contains("updatePosition REMOTE")) {
-                parseUpdatePosition(logLine);
-            }
+    if (logLine.contains("Received text msg")) {
+        parseTextData(logLine);
+    }
 
-            if (logLine.contains("node=")) {
-                parsePositionData(logLine);
-            }
+    if (logLine.contains("updatePosition REMOTE")) {
+        parseUpdatePosition(logLine);
+    }
 
-            if (logLine.contains("Node status update:")) {
-                parseNodeStatus(logLine);
-            }
+    if (logLine.contains("updatePosition LOCAL")) {
+        parseLocalPosition(logLine);
+    }
 
-            //turn on debug logs
-            if (get_debug_status()){
-                emit logMessage("DEBUG: " + logLine);
-            }
+    if (logLine.contains("node=")) {
+        parsePositionData(logLine);
+    }
+
+    if (logLine.contains("Node status update:")) {
+        parseNodeStatus(logLine);
+    }
+
+    if (logLine.contains("user ") && logLine.contains("channel=")) {
+        parseNodeInfo(logLine);
+    }
+
+    if (logLine.contains("NEIGHBORINFO") || logLine.contains("neighbors") || logLine.contains("node_id=")) {
+        parseNeighborInfo(logLine);
+    }
+
+    if (logLine.contains("Set radio:") || (logLine.contains("bw=") && logLine.contains("sf="))) {
+        parseRadioConfig(logLine);
+    }
+
+    //turn on debug logs
+    if (get_debug_status()){
+        emit logMessage("DEBUG: " + logLine);
+    }
+}
+
+void meshtastic_handler::processProtobufPacket(const meshtastic::MeshPacket& packet) {
+    if (!packet.has_decoded() || packet.decoded().portnum() != meshtastic::TRACEROUTE_APP) {
+        return;
+    }
+    // Requests carry an empty route, only replies (which answer a request id) are useful
+    const meshtastic::Data& data = packet.decoded();
+    meshtastic::RouteDiscovery discovery;
+    if (data.request_id() == 0 || !discovery.ParseFromString(data.payload())) {
+        DEBUG_PACKET("Ignoring traceroute packet without a decodable reply");
+        return;
+    }
+
+    // The reply comes from the traced node; SNRs are sent as dB * 4 with INT8_MIN for unknown
+    auto snr = [](int32_t scaled) { return scaled == INT8_MIN ? NAN : scaled / 4.0f; };
+    route_trace trace;
+    trace.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    trace.target = packet.from();
+    trace.requester = packet.to();
+    trace.requestId = data.request_id();
+
+    trace.forward.append(trace.requester);
+    for (quint32 hop : discovery.route()) {
+        trace.forward.append(hop);
+    }
+    trace.forward.append(trace.target);
+    for (int32_t value : discovery.snr_towards()) {
+        trace.snrTowards.append(snr(value));
+    }
+
+    // Older firmware doesn't fill the way back
+    if (discovery.snr_back_size() > 0) {
+        trace.back.append(trace.target);
+        for (quint32 hop : discovery.route_back()) {
+            trace.back.append(hop);
+        }
+        trace.back.append(trace.requester);
+        for (int32_t value : discovery.snr_back()) {
+            trace.snrBack.append(snr(value));
         }
     }
+
+    DEBUG_PACKET("Traceroute reply from" << trace.target << "with" << trace.hops() << "hops");
+    emit routeDiscovered(trace);
 }
 
+// Writes with the same 0x94 0xC3 + length framing the radio uses
+bool meshtastic_handler::writeToRadio(const meshtastic::ToRadio& message) {
+    if (!isRunning()) {
+        return false;
+    }
+    std::string payload = message.SerializeAsString();
+    if (payload.size() > 0xffff) {
+        return false;
+    }
+    QByteArray frame;
+    frame.reserve(4 + static_cast<int>(payload.size()));
+    frame.append(static_cast<char>(0x94));
+    frame.append(static_cast<char>(0xC3));
+    frame.append(static_cast<char>((payload.size() >> 8) & 0xff));
+    frame.append(static_cast<char>(payload.size() & 0xff));
+    frame.append(payload.data(), static_cast<int>(payload.size()));
+
+    if (serialPort->write(frame) != frame.size()) {
+        ERROR_PRINT("Failed to write to radio:" << serialPort->errorString());
+        return false;
+    }
+    return true;
+}
+
+// Switches the connection from the plain text debug log to the protobuf API, which is
+// the only way to send packets. From then on the firmware frames everything: mesh
+// packets arrive as FromRadio packets and its log only as LogRecords, which are fed
+// back through processLine. The firmware sends LogRecords only when
+// security.debug_log_api_enabled is set on the node; without it every log-based view
+// (packets, positions, telemetry, battery) stops updating until the radio is
+// reconnected. That's why this is never done implicitly.
+bool meshtastic_handler::startApiSession() {
+    if (apiSession) {
+        return true;
+    }
+    meshtastic::ToRadio wantConfig;
+    wantConfig.set_want_config_id(QRandomGenerator::global()->bounded(1u, 0xffffffffu));
+    if (!writeToRadio(wantConfig)) {
+        ERROR_PRINT("Failed to start the API session");
+        return false;
+    }
+    apiSession = true;
+    heartbeatTimer->start();
+    emit logMessage("API session started, the firmware log now only arrives if debug_log_api_enabled is set", "warning");
+    emit apiSessionChanged(true);
+    return true;
+}
+
+// Wraps a MeshPacket in a ToRadio message, only possible inside an API session
+bool meshtastic_handler::sendTraceroute(quint32 target, quint32 packetId) {
+    if (!apiSession) {
+        WARNING_PRINT("Traceroute to" << target << "needs an API session, not sent");
+        emit tracerouteFailed(target, packetId);
+        return false;
+    }
+
+    meshtastic::RouteDiscovery discovery;
+    meshtastic::ToRadio toRadio;
+    meshtastic::MeshPacket* packet = toRadio.mutable_packet();
+    packet->set_to(target);
+    packet->set_id(packetId);
+    packet->set_hop_limit(TRACEROUTE_HOP_LIMIT);
+    packet->set_want_ack(true);
+    meshtastic::Data* data = packet->mutable_decoded();
+    data->set_portnum(meshtastic::TRACEROUTE_APP);
+    data->set_payload(discovery.SerializeAsString());
+    data->set_want_response(true);
+
+    if (!writeToRadio(toRadio)) {
+        emit tracerouteFailed(target, packetId);
+        return false;
+    }
+    DEBUG_PACKET("Sent traceroute to" << target << "id" << packetId);
+    return true;
+}
 
 QString meshtastic_handler::getPortnumString(int portnum) {
     switch (portnum) {
@@ -309,10 +476,34 @@ QString meshtastic_handler::getPortnumString(int portnum) {
     case 67: return "TELEMETRY_APP";
     case 68: return "ZPS_APP";
     case 69: return "SIMULATOR_APP";
+    case 70: return "TRACEROUTE_APP";
     default: return QString("UNKNOWN_%1").arg(portnum);
     }
 }
 
+void meshtastic_handler::setLocalNode(quint32 nodeNum) {
+    if (nodeNum != 0 && nodeNum != 0xffffffff && nodeNum != localNodeNum) {
+        localNodeNum = nodeNum;
+        DEBUG_PACKET("Local node is" << QString::number(nodeNum, 16));
+        emit localNodeDetected(localNodeNum);
+    }
+}
+
+// Every packet the radio originates (its own NodeInfo, telemetry and position broadcasts
+// included) is logged as "Enqueued local (id=0x.. fr=0x.. ...", so this shows up within
+// minutes even when NeighborInfo is off
+void meshtastic_handler::parseEnqueuedLocal(QString logLine) {
+    static const QRegularExpression localRegex(R"(Enqueued local \(id=0x[a-fA-F0-9]+\s+fr=0x([a-fA-F0-9]+))");
+    QRegularExpressionMatch match = localRegex.match(logLine);
+    bool ok;
+    if (match.hasMatch()) {
+        quint32 local = match.captured(1).toUInt(&ok, 16);
+        if (ok) {
+            setLocalNode(local);
+        }
+    }
+}
+
 void meshtastic_handler::parseNodeStatus(QString logLine) {
     DEBUG_PACKET("parseNodeStatus called with:" << logLine);
 
@@ -345,6 +536,107 @@ void meshtastic_handler::parseNodeStatus(QString logLine) {
     }
 }
 
+void meshtastic_handler::parseNodeInfo(QString logLine) {
+    DEBUG_PACKET("parseNodeInfo called with:" << logLine);
+
+    // NodeDB logs the user record when a NODEINFO arrives, the short name isn't part of it
+    QRegularExpression nodeInfoRegex(R"(user\s+!?([a-fA-F0-9]{1,8})/([^,]*),\s*channel=(\d+))");
+    QRegularExpressionMatch match = nodeInfoRegex.match(logLine);
+
+    if (match.hasMatch()) {
+        bool ok;
+        quint32 nodeNum = match.captured(1).toUInt(&ok, 16);
+        QString longName = match.captured(2).trimmed();
+        if (ok && nodeNum != 0) {
+            emit nodeInfoUpdate(nodeNum, QString(), longName);
+        }
+        DEBUG_PACKET("Node info - Node:" << match.captured(1) << "Long name:" << longName);
+    }
+}
+
+void meshtastic_handler::parseNeighborInfo(QString logLine) {
+    DEBUG_PACKET("parseNeighborInfo called with:" << logLine);
+
+    // NeighborInfoModule prints: "<header> NEIGHBORINFO PACKET from Node 0x.. to Node 0x.. (last sent by 0x..)",
+    // "Packet contains N neighbors", then "Neighbor i: node_id=0x.., snr=x.xx" per neighbor
+    static const QRegularExpression headerRegex(R"(NEIGHBORINFO PACKET from Node 0x([a-fA-F0-9]+) to Node 0x([a-fA-F0-9]+))");
+    static const QRegularExpression countRegex(R"(Packet contains (\d+) neighbors)");
+    static const QRegularExpression neighborRegex(R"(Neighbor \d+: node_id=0x([a-fA-F0-9]+), snr=(-?\d+(?:\.\d+)?))");
+
+    bool ok;
+    QRegularExpressionMatch match = headerRegex.match(logLine);
+    if (match.hasMatch()) {
+        neighborSource = match.captured(1).toUInt(&ok, 16);
+        neighborsExpected = -1;
+        neighborList.clear();
+        // The receiving side of the header is always the radio we're attached to
+        quint32 local = match.captured(2).toUInt(&ok, 16);
+        if (ok) {
+            setLocalNode(local);
+        }
+        return;
+    }
+    if (neighborSource == 0) {
+        return;
+    }
+
+    match = countRegex.match(logLine);
+    if (match.hasMatch()) {
+        neighborsExpected = match.captured(1).toInt();
+    } else {
+        match = neighborRegex.match(logLine);
+        if (!match.hasMatch()) {
+            return;
+        }
+        neighborList.append(qMakePair(match.captured(1).toUInt(&ok, 16), match.captured(2).toFloat()));
+    }
+
+    if (neighborsExpected >= 0 && neighborList.size() >= neighborsExpected) {
+        emit neighborInfo(neighborSource, neighborList, QDateTime::currentMSecsSinceEpoch());
+        neighborSource = 0;
+        neighborsExpected = -1;
+        neighborList.clear();
+    }
+}
+
+void meshtastic_handler::parseRadioConfig(QString logLine) {
+    DEBUG_PACKET("parseRadioConfig called with:" << logLine);
+
+    // RadioInterface prints the preset's display name when it applies the config, some
+    // builds also print the raw modem settings
+    static const QRegularExpression presetRegex(R"(Set radio:.*name=(\w+))");
+    static const QRegularExpression modemRegex(R"(bw=(\d+(?:\.\d+)?)[^\d]+sf=(\d+)[^\d]+cr=4/(\d))");
+    static const QHash<QString, meshtastic::Config_LoRaConfig_ModemPreset> presets = {
+        {"LongFast", meshtastic::Config_LoRaConfig_ModemPreset_LONG_FAST},
+        {"LongSlow", meshtastic::Config_LoRaConfig_ModemPreset_LONG_SLOW},
+        {"VLongSlow", lora_airtime::VERY_LONG_SLOW},
+        {"MediumSlow", meshtastic::Config_LoRaConfig_ModemPreset_MEDIUM_SLOW},
+        {"MediumFast", meshtastic::Config_LoRaConfig_ModemPreset_MEDIUM_FAST},
+        {"ShortSlow", meshtastic::Config_LoRaConfig_ModemPreset_SHORT_SLOW},
+        {"ShortFast", meshtastic::Config_LoRaConfig_ModemPreset_SHORT_FAST},
+        {"LongMod", meshtastic::Config_LoRaConfig_ModemPreset_LONG_MODERATE},
+        {"ShortTurbo", meshtastic::Config_LoRaConfig_ModemPreset_SHORT_TURBO},
+    };
+
+    meshtastic::Config_LoRaConfig config;
+    QRegularExpressionMatch match = modemRegex.match(logLine);
+    if (match.hasMatch()) {
+        config.set_use_preset(false);
+        // Printed in kHz (203.125), stored as the config's code (200)
+        config.set_bandwidth(lora_airtime::bandwidthCode(match.captured(1).toDouble()));
+        config.set_spread_factor(match.captured(2).toUInt());
+        config.set_coding_rate(match.captured(3).toUInt());
+    } else {
+        match = presetRegex.match(logLine);
+        if (!match.hasMatch() || !presets.contains(match.captured(1))) {
+            return;
+        }
+        config.set_use_preset(true);
+        config.set_modem_preset(presets.value(match.captured(1)));
+    }
+    emit loraConfigDetected(config);
+}
+
 void meshtastic_handler::parseHandleReceivedData(QString logLine) {
     DEBUG_PACKET("parseHandleReceivedData called with:" << logLine);
 
@@ -376,10 +668,36 @@ void meshtastic_handler::parseHandleReceivedData(QString logLine) {
         int transport = match.captured(4).toInt();
         int portnum = match.captured(8).toInt();
 
+        mesh_event event;
+        event.timestampMs = QDateTime::currentMSecsSinceEpoch();
+        event.kind = mesh_event::Packet;
+        event.from = static_cast<quint32>(from);
+        event.to = static_cast<quint32>(to);
+        event.packetId = static_cast<quint32>(id);
+        event.portnum = portnum;
+        event.channel = match.captured(7).toInt(&ok, 16);
+        event.rxSnr = match.captured(10).isEmpty() ? NAN : match.captured(10).toFloat();
+        event.rxRssi = match.captured(11).toInt();
+        event.hopLimit = match.captured(6).toInt();
+        event.hopStart = match.captured(12).isEmpty() ? 3 : match.captured(12).toInt();
+        // Newer firmware also prints the relaying node
+        static const QRegularExpression relayRegex(R"(relay=0x([a-fA-F0-9]+))");
+        QRegularExpressionMatch relayMatch = relayRegex.match(logLine);
+        if (relayMatch.hasMatch()) {
+            event.relayNode = static_cast<int>(relayMatch.captured(1).toUInt(&ok, 16) & 0xff);
+        }
+        static const QRegularExpression lengthRegex(R"(\b(?:payload)?len=(\d+))", QRegularExpression::CaseInsensitiveOption);
+        QRegularExpressionMatch lengthMatch = lengthRegex.match(logLine);
+        if (lengthMatch.hasMatch()) {
+            event.payloadLength = lengthMatch.captured(1).toInt();
+        }
+        event.level = "packet";
+
         if (portnum == 1) {
             // TEXT MESSAGE - store for later merging, don't emit yet
             packetData["transport"] = transport;
             pendingPackets[messageId] = packetData;
+            pendingEvents[messageId] = event;
             DEBUG_PACKET("Stored TEXT packet for merging with message ID:" << messageId);
         } else {
             // NON-TEXT MESSAGE - emit immediately with decoded section
@@ -396,6 +714,9 @@ void meshtastic_handler::parseHandleReceivedData(QString logLine) {
 
             QString packetDataString = QJsonDocument(packetData).toJson(QJsonDocument::Compact);
             //emit logMessage(packetDataString, "packet");
+
+            event.json = packetDataString.toUtf8();
+            emit eventParsed(event);
         }
     }
 }
@@ -458,6 +779,12 @@ void meshtastic_handler::parseTextData(QString logLine) {
             QString finalJson = QJsonDocument(packetData).toJson(QJsonDocument::Compact);
             emit logMessage(finalJson, "packet");
 
+            mesh_event event = pendingEvents.take(messageId);
+            event.kind = mesh_event::Text;
+            event.text = cleanText;
+            event.json = finalJson.toUtf8();
+            emit eventParsed(event);
+
             DEBUG_PACKET("Merged complete packet for message ID:" << messageId << "Text:" << cleanText);
 
         } else {
@@ -473,6 +800,18 @@ void meshtastic_handler::parseTextData(QString logLine) {
             QString textOnlyJson = QJsonDocument(textOnly).toJson(QJsonDocument::Compact);
             emit logMessage(textOnlyJson, "info");
 
+            bool ok;
+            mesh_event event;
+            event.timestampMs = currentTime.toMSecsSinceEpoch();
+            event.kind = mesh_event::Text;
+            event.from = match.captured(1).toUInt(&ok, 16);
+            event.packetId = messageId.toUInt(&ok, 16);
+            event.portnum = 1;
+            event.level = "info";
+            event.text = cleanText;
+            event.json = textOnlyJson.toUtf8();
+            emit eventParsed(event);
+
             DEBUG_PACKET("No stored packet data for message ID:" << messageId << ", output text-only");
         }
     }
@@ -496,6 +835,7 @@ void meshtastic_handler::parseBatteryData(QString logLine) {
             QString battery_status= QString::number(batteryPercent);
             emit logBattery(battery_status);
         }
+        emit localBattery(localNodeNum, batteryPercent, usbPower == 1 || isCharging == 1, QDateTime::currentMSecsSinceEpoch());
 
         // Convert to more readable values
         double voltageVolts = batteryVoltage / 1000.0;
@@ -516,6 +856,23 @@ void meshtastic_handler::parseBatteryData(QString logLine) {
     }
 }
 
+// The firmware logs one received position twice, as "POSITION node=" and as
+// "updatePosition REMOTE". Whichever comes first is used, the other is dropped here so
+// it adds neither a second track point nor a second event (packetId is 0 on both, the
+// duplicate filter can't pair them)
+bool meshtastic_handler::isRepeatedPosition(quint32 nodeNum, qint32 latitudeI, qint32 longitudeI) {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    RecentPosition& last = recentPositions[nodeNum];
+    bool repeated = last.latitudeI == latitudeI && last.longitudeI == longitudeI
+                    && now - last.seenMs < POSITION_REPEAT_MS;
+    if (!repeated) {
+        last.latitudeI = latitudeI;
+        last.longitudeI = longitudeI;
+        last.seenMs = now;
+    }
+    return repeated;
+}
+
 void meshtastic_handler::parsePositionData(QString logLine) {
     DEBUG_PACKET("parsePositionData called with:" << logLine);
 
@@ -527,6 +884,10 @@ void meshtastic_handler::parsePositionData(QString logLine) {
         double latitude = match.captured(2).toDouble() / 10000000.0;
         double longitude = match.captured(3).toDouble() / 10000000.0;
         int altitude = match.captured(4).toInt();
+        bool ok;
+        if (isRepeatedPosition(nodeId.toUInt(&ok, 16), match.captured(2).toInt(), match.captured(3).toInt())) {
+            return;
+        }
 
         // Create position JSON object
         QJsonObject positionData;
@@ -543,6 +904,20 @@ void meshtastic_handler::parsePositionData(QString logLine) {
         QString positionJson = QJsonDocument(positionData).toJson(QJsonDocument::Compact);
         emit logMessage(positionJson, "position");
 
+        emit positionUpdate(QString("!%1").arg(nodeId), latitude, longitude, currentTime.toMSecsSinceEpoch());
+
+        mesh_event event;
+        event.timestampMs = currentTime.toMSecsSinceEpoch();
+        event.kind = mesh_event::Position;
+        event.from = nodeId.toUInt(&ok, 16);
+        event.portnum = 3;
+        event.latitude = latitude;
+        event.longitude = longitude;
+        event.altitude = altitude;
+        event.level = "position";
+        event.json = positionJson.toUtf8();
+        emit eventParsed(event);
+
         DEBUG_PACKET("GPS - Node:" << nodeId << "Lat:" << latitude << "Lon:" << longitude << "Alt:" << altitude);
     }
 }
@@ -559,6 +934,10 @@ void meshtastic_handler::parseUpdatePosition(QString logLine) {
                 qDebug() << "GPS UPDATE from node:" << nodeId << "at" << QTime::currentTime();
         double latitude = match.captured(3).toDouble() / 10000000.0;
         double longitude = match.captured(4).toDouble() / 10000000.0;
+        bool ok;
+        if (isRepeatedPosition(nodeId.toUInt(&ok, 16), match.captured(3).toInt(), match.captured(4).toInt())) {
+            return;
+        }
 
         QJsonObject positionData;
         positionData["nodeId"] = QString("!%1").arg(nodeId);
@@ -569,10 +948,27 @@ void meshtastic_handler::parseUpdatePosition(QString logLine) {
         QDateTime currentTime = QDateTime::currentDateTime();
         positionData["timestamp"] = currentTime.toString("yyyy-MM-dd hh:mm:ss");
 
+        // Prefer the fix time from the node, it is 0 when the node has no GPS time
+        qint64 fixTimeMs = match.captured(2).toLongLong() * 1000;
+        if (fixTimeMs <= 0) {
+            fixTimeMs = currentTime.toMSecsSinceEpoch();
+        }
+
         QString positionJson = QJsonDocument(positionData).toJson(QJsonDocument::Compact);
         emit logMessage(positionJson, "position");
 
-        emit positionUpdate(QString("!%1").arg(nodeId), latitude, longitude);
+        emit positionUpdate(QString("!%1").arg(nodeId), latitude, longitude, fixTimeMs);
+
+        mesh_event event;
+        event.timestampMs = currentTime.toMSecsSinceEpoch();
+        event.kind = mesh_event::Position;
+        event.from = nodeId.toUInt(&ok, 16);
+        event.portnum = 3;
+        event.latitude = latitude;
+        event.longitude = longitude;
+        event.level = "position";
+        event.json = positionJson.toUtf8();
+        emit eventParsed(event);
 
         DEBUG_PACKET("GPS Update - Node:" << nodeId << "Lat:" << latitude << "Lon:" << longitude);
         qDebug() << "EMITTED POSITION JSON:" << positionJson;
@@ -581,6 +977,27 @@ void meshtastic_handler::parseUpdatePosition(QString logLine) {
     }
 }
 
+void meshtastic_handler::parseLocalPosition(QString logLine) {
+    DEBUG_PACKET("parseLocalPosition called with:" << logLine);
+
+    // PositionModule prints "updatePosition LOCAL pos@<ts> time=<s> lat=<1e-7 deg> lon=<1e-7 deg> alt=<m>"
+    static const QRegularExpression localPosRegex(R"(updatePosition\s+LOCAL\b.*?\blat=(-?\d+)\s+lon=(-?\d+))");
+    QRegularExpressionMatch match = localPosRegex.match(logLine);
+    if (!match.hasMatch()) {
+        return;
+    }
+    qint32 latitudeI = match.captured(1).toInt();
+    qint32 longitudeI = match.captured(2).toInt();
+    // 0/0 is what the firmware reports before it has a fix
+    if (latitudeI == 0 && longitudeI == 0) {
+        return;
+    }
+    double latitude = latitudeI / 10000000.0;
+    double longitude = longitudeI / 10000000.0;
+    DEBUG_PACKET("Local position:" << latitude << longitude);
+    emit localPositionUpdate(latitude, longitude, QDateTime::currentMSecsSinceEpoch());
+}
+
 void meshtastic_handler::parseSenderData(QString logLine) {
     QJsonObject senderData;
     QRegularExpression senderRegex(R"(\(Received from ([a-fA-F0-9]+)\): air_util_tx=([0-9.]+), channel_utilization=([0-9.]+), battery_level=(\d+), voltage=([0-9.]+))");
@@ -604,6 +1021,21 @@ void meshtastic_handler::parseSenderData(QString logLine) {
     }
     QString senderDataString = QJsonDocument(senderData).toJson(QJsonDocument::Compact);
     emit logMessage(senderDataString);
+
+    // Device metrics come in as telemetry from the sending node
+    bool ok;
+    mesh_event event;
+    event.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    event.kind = mesh_event::Telemetry;
+    event.from = match.captured(1).toUInt(&ok, 16);
+    event.portnum = 67;
+    event.airUtilTx = match.captured(2).toFloat();
+    event.channelUtilization = match.captured(3).toFloat();
+    event.batteryLevel = match.captured(4).toInt();
+    event.voltage = match.captured(5).toFloat();
+    event.level = "info";
+    event.json = senderDataString.toUtf8();
+    emit eventParsed(event);
 }
 
 
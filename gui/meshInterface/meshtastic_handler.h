@@ -9,12 +9,18 @@
 #include <QTimer>
 #include <QDebug>
 #include "debug_config.h"
+#include "mesh_event.h"
+#include "route_trace.h"
+#include <QVector>
+#include <QPair>
+#include <QHash>
 
 
 //protobuf defines
 #include "meshtastic/mesh.pb.h"
 #include "meshtastic/portnums.pb.h"
 #include "meshtastic/telemetry.pb.h"
+#include "meshtastic/config.pb.h"
 
 class meshtastic_handler : public QObject
 {
@@ -44,6 +50,11 @@ public:
         debug_status = status;
     }
 
+    // See startApiSession, traceroutes can only be sent while one is running
+    bool apiSessionActive() const {
+        return apiSession;
+    }
+
 
 public slots:
     void startMeshtastic(const QString& portName = "");
@@ -52,6 +63,8 @@ public slots:
     void parseBatteryData(QString logLine);
     void parseSenderData(QString logLine);
     void parseHandleReceivedData(QString logLine);
+    bool startApiSession();
+    bool sendTraceroute(quint32 target, quint32 packetId);
 
 signals:
     void stateChanged(Connection_Status state);
@@ -61,7 +74,20 @@ signals:
    // void rawDataReceived(const QString&(const QString& msg);
     void logBattery(const QString& msg);
     void logNodesOnline(const QString& num_nodes);
-    void positionUpdate(const QString& nodeId, double lat, double lon);
+    void positionUpdate(const QString& nodeId, double lat, double lon, qint64 timestampMs);
+    void localPositionUpdate(double lat, double lon, qint64 timestampMs);
+    // Every battery report from the local firmware, not just the changed percentages logBattery sees.
+    // nodeNum is 0 until localNodeDetected has fired
+    void localBattery(quint32 nodeNum, int percent, bool externalPower, qint64 timestampMs);
+    void eventParsed(const mesh_event& event);
+    void nodeInfoUpdate(quint32 nodeNum, const QString& shortName, const QString& longName);
+    void neighborInfo(quint32 nodeNum, const QVector<QPair<quint32, float>>& neighbors, qint64 timestampMs);
+    void localNodeDetected(quint32 nodeNum);
+    void routeDiscovered(const route_trace& trace);
+    void apiSessionChanged(bool active);
+    // sendTraceroute refused or couldn't write the request, no reply will come for packetId
+    void tracerouteFailed(quint32 target, quint32 packetId);
+    void loraConfigDetected(const meshtastic::Config_LoRaConfig& config);
 
 private slots:
     void onSerialDataReady();
@@ -70,7 +96,14 @@ private slots:
 private:
     QString findMeshtasticPort();
     void processData(const QByteArray& data);
-    void processLine(const QString& line);
+    void processLine(const QString& logLine);
+
+    static const int TRACEROUTE_HOP_LIMIT = 7;
+    static const int HEARTBEAT_MS = 5 * 60 * 1000;
+
+    bool writeToRadio(const meshtastic::ToRadio& message);
+    QTimer* heartbeatTimer;
+    bool apiSession = false;
 
     QJsonObject parseMessage(const QString& line);
     QSerialPort* serialPort;
@@ -80,10 +113,30 @@ private:
     void processProtobufPacket(const meshtastic::MeshPacket& packet);
     bool debug_status;
     QMap<QString, QJsonObject> pendingPackets;
+    QMap<QString, mesh_event> pendingEvents;
     QString getPortnumString(int portnum);
     void parsePositionData(QString logLine);
+    bool isRepeatedPosition(quint32 nodeNum, qint32 latitudeI, qint32 longitudeI);
+    static const qint64 POSITION_REPEAT_MS = 10 * 1000;
+    struct RecentPosition {
+        qint32 latitudeI = 0;
+        qint32 longitudeI = 0;
+        qint64 seenMs = 0;
+    };
+    QHash<quint32, RecentPosition> recentPositions;
     void parseUpdatePosition(QString logLine);
+    void parseLocalPosition(QString logLine);
     void parseNodeStatus(QString logLine);
+    void parseNodeInfo(QString logLine);
+    void parseNeighborInfo(QString logLine);
+    void parseRadioConfig(QString logLine);
+    void parseEnqueuedLocal(QString logLine);
+    void setLocalNode(quint32 nodeNum);
+    // NeighborInfo is printed as a header line followed by one line per neighbor
+    quint32 neighborSource = 0;
+    int neighborsExpected = -1;
+    QVector<QPair<quint32, float>> neighborList;
+    quint32 localNodeNum = 0;
     int prev_battery_status;
     int cur_battery_status;
     int prev_nodes_num;
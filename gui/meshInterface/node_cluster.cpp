@@ -0,0 +1,230 @@
+#include "node_cluster.h"
+#include <QtMath>
+#include <QPair>
+#include <algorithm>
+
+namespace {
+const double MAX_MERCATOR_LAT = 85.05112878;
+}
+
+node_cluster::node_cluster() {}
+
+double node_cluster::mercatorX(double lon) {
+    lon = std::clamp(lon, -180.0, 180.0);
+    return (lon + 180.0) / 360.0;
+}
+
+double node_cluster::mercatorY(double lat) {
+    lat = std::clamp(lat, -MAX_MERCATOR_LAT, MAX_MERCATOR_LAT);
+    double rad = qDegreesToRadians(lat);
+    return (1.0 - std::log(std::tan(rad) + 1.0 / std::cos(rad)) / M_PI) / 2.0;
+}
+
+int node_cluster::cellsPerAxis(int level) {
+    return (1 << level) * (256 / CELL_PIXELS);
+}
+
+quint64 node_cluster::cellKey(quint32 cx, quint32 cy) {
+    return (static_cast<quint64>(cx) << 32) | cy;
+}
+
+quint64 node_cluster::cellFor(int level, double lat, double lon) {
+    int n = cellsPerAxis(level);
+    quint32 cx = static_cast<quint32>(std::clamp(static_cast<int>(mercatorX(lon) * n), 0, n - 1));
+    quint32 cy = static_cast<quint32>(std::clamp(static_cast<int>(mercatorY(lat) * n), 0, n - 1));
+    return cellKey(cx, cy);
+}
+
+bool node_cluster::updateNode(const QString& nodeId, double lat, double lon) {
+    auto it = nodes.find(nodeId);
+    bool isNew = (it == nodes.end());
+
+    NodePos pos;
+    pos.lat = lat;
+    pos.lon = lon;
+    for (int level = 0; level < LEVELS; ++level) {
+        pos.keys[level] = cellFor(level, lat, lon);
+    }
+
+    if (isNew) {
+        for (int level = 0; level < LEVELS; ++level) {
+            addToCell(level, pos.keys[level], nodeId, lat, lon);
+        }
+        nodes.insert(nodeId, pos);
+        return true;
+    }
+
+    // Only the levels whose cell changed need their membership touched
+    const NodePos old = it.value();
+    for (int level = 0; level < LEVELS; ++level) {
+        if (old.keys[level] == pos.keys[level]) {
+            Cell& cell = grid[level][pos.keys[level]];
+            cell.sumLat += lat - old.lat;
+            cell.sumLon += lon - old.lon;
+        } else {
+            removeFromCell(level, old.keys[level], nodeId, old.lat, old.lon);
+            addToCell(level, pos.keys[level], nodeId, lat, lon);
+        }
+    }
+    it.value() = pos;
+    return false;
+}
+
+bool node_cluster::removeNode(const QString& nodeId) {
+    auto it = nodes.find(nodeId);
+    if (it == nodes.end()) {
+        return false;
+    }
+    for (int level = 0; level < LEVELS; ++level) {
+        removeFromCell(level, it->keys[level], nodeId, it->lat, it->lon);
+    }
+    nodes.erase(it);
+    return true;
+}
+
+bool node_cluster::contains(const QString& nodeId) const {
+    return nodes.contains(nodeId);
+}
+
+bool node_cluster::position(const QString& nodeId, double& lat, double& lon) const {
+    auto it = nodes.constFind(nodeId);
+    if (it == nodes.constEnd()) {
+        return false;
+    }
+    lat = it->lat;
+    lon = it->lon;
+    return true;
+}
+
+int node_cluster::size() const {
+    return nodes.size();
+}
+
+void node_cluster::clear() {
+    nodes.clear();
+    for (int level = 0; level < LEVELS; ++level) {
+        grid[level].clear();
+    }
+}
+
+void node_cluster::addToCell(int level, quint64 key, const QString& nodeId, double lat, double lon) {
+    Cell& cell = grid[level][key];
+    cell.count++;
+    cell.sumLat += lat;
+    cell.sumLon += lon;
+    cell.members.insert(nodeId);
+}
+
+void node_cluster::removeFromCell(int level, quint64 key, const QString& nodeId, double lat, double lon) {
+    auto it = grid[level].find(key);
+    if (it == grid[level].end()) {
+        return;
+    }
+    it->count--;
+    it->sumLat -= lat;
+    it->sumLon -= lon;
+    it->members.remove(nodeId);
+    if (it->count <= 0) {
+        grid[level].erase(it);
+    }
+}
+
+bool node_cluster::inViewport(const Viewport& view, double lat, double lon) {
+    if (lat < view.south || lat > view.north) {
+        return false;
+    }
+    if (view.east - view.west >= 360.0) {
+        return true;
+    }
+    // West greater than east: the viewport crosses the antimeridian (see map_bridge)
+    if (view.west > view.east) {
+        return lon >= view.west || lon <= view.east;
+    }
+    return lon >= view.west && lon <= view.east;
+}
+
+void node_cluster::emitCell(int level, quint64 key, const Cell& cell, bool split, QVector<Item>& out) const {
+    if (cell.count == 1 || split) {
+        for (const QString& nodeId : cell.members) {
+            const NodePos pos = nodes.value(nodeId);
+            Item item;
+            item.key = nodeId;
+            item.nodeId = nodeId;
+            item.lat = pos.lat;
+            item.lon = pos.lon;
+            item.count = 1;
+            out.append(item);
+        }
+        return;
+    }
+
+    Item item;
+    item.key = QString("c%1_%2").arg(level).arg(key);
+    item.lat = cell.sumLat / cell.count;
+    item.lon = cell.sumLon / cell.count;
+    item.count = cell.count;
+    out.append(item);
+}
+
+QVector<node_cluster::Item> node_cluster::query(const Viewport& view) const {
+    QVector<Item> out;
+    if (nodes.isEmpty()) {
+        return out;
+    }
+
+    int level = std::clamp(view.zoom, 0, MAX_CLUSTER_ZOOM);
+    bool split = view.zoom > MAX_CLUSTER_ZOOM;
+    const QHash<quint64, Cell>& cells = grid[level];
+    int n = cellsPerAxis(level);
+
+    auto column = [n](double lon) {
+        return std::clamp(static_cast<qint64>(mercatorX(lon) * n), qint64(0), qint64(n - 1));
+    };
+    // Column ranges on screen, two when the viewport crosses the antimeridian
+    QVector<QPair<qint64, qint64>> columns;
+    if (view.east - view.west >= 360.0) {
+        columns.append({0, n - 1});
+    } else if (view.west > view.east) {
+        columns.append({column(view.west), n - 1});
+        columns.append({0, column(view.east)});
+    } else {
+        columns.append({column(view.west), column(view.east)});
+    }
+    qint64 y0 = std::clamp(static_cast<qint64>(mercatorY(view.north) * n), qint64(0), qint64(n - 1));
+    qint64 y1 = std::clamp(static_cast<qint64>(mercatorY(view.south) * n), qint64(0), qint64(n - 1));
+
+    qint64 rangeCells = 0;
+    for (const auto& range : columns) {
+        rangeCells += (range.second - range.first + 1) * (y1 - y0 + 1);
+    }
+
+    // Walk whichever is smaller: the cells on screen or the occupied cells
+    if (rangeCells <= cells.size()) {
+        for (const auto& range : columns) {
+            for (qint64 cx = range.first; cx <= range.second; ++cx) {
+                for (qint64 cy = y0; cy <= y1; ++cy) {
+                    quint64 key = cellKey(static_cast<quint32>(cx), static_cast<quint32>(cy));
+                    auto it = cells.constFind(key);
+                    if (it != cells.constEnd()) {
+                        emitCell(level, key, it.value(), split, out);
+                    }
+                }
+            }
+        }
+    } else {
+        for (auto it = cells.constBegin(); it != cells.constEnd(); ++it) {
+            qint64 cx = static_cast<qint64>(it.key() >> 32);
+            qint64 cy = static_cast<qint64>(it.key() & 0xffffffffu);
+            if (cy < y0 || cy > y1) {
+                continue;
+            }
+            for (const auto& range : columns) {
+                if (cx >= range.first && cx <= range.second) {
+                    emitCell(level, it.key(), it.value(), split, out);
+                    break;
+                }
+            }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,80 @@
+#ifndef NODE_CLUSTER_H
+#define NODE_CLUSTER_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+// Grid based clustering of node positions for the map.
+// Every zoom level keeps its own grid of occupied cells that is updated
+// incrementally as positions arrive, so a viewport query only has to walk the
+// cells that are on screen instead of every known node.
+class node_cluster
+{
+public:
+    // Longitudes as map_bridge hands them over, west > east when the view crosses 180°
+    struct Viewport {
+        double south = 0.0;
+        double west = 0.0;
+        double north = 0.0;
+        double east = 0.0;
+        int zoom = 0;
+    };
+
+    // A single node (count == 1) or a cluster of nodes (count > 1)
+    struct Item {
+        QString key;
+        QString nodeId;
+        double lat = 0.0;
+        double lon = 0.0;
+        int count = 0;
+    };
+
+    // Cells are CELL_PIXELS wide on screen, above MAX_CLUSTER_ZOOM every node is drawn
+    static constexpr int CELL_PIXELS = 64;
+    static constexpr int MAX_CLUSTER_ZOOM = 16;
+
+    node_cluster();
+
+    // Returns true if the node was not known before
+    bool updateNode(const QString& nodeId, double lat, double lon);
+    bool removeNode(const QString& nodeId);
+    bool contains(const QString& nodeId) const;
+    bool position(const QString& nodeId, double& lat, double& lon) const;
+    int size() const;
+    void clear();
+
+    QVector<Item> query(const Viewport& view) const;
+    static bool inViewport(const Viewport& view, double lat, double lon);
+
+private:
+    static constexpr int LEVELS = MAX_CLUSTER_ZOOM + 1;
+
+    struct Cell {
+        int count = 0;
+        double sumLat = 0.0;
+        double sumLon = 0.0;
+        QSet<QString> members;
+    };
+
+    struct NodePos {
+        double lat = 0.0;
+        double lon = 0.0;
+        quint64 keys[LEVELS];
+    };
+
+    QHash<QString, NodePos> nodes;
+    QHash<quint64, Cell> grid[LEVELS];
+
+    static double mercatorX(double lon);
+    static double mercatorY(double lat);
+    static int cellsPerAxis(int level);
+    static quint64 cellKey(quint32 cx, quint32 cy);
+    static quint64 cellFor(int level, double lat, double lon);
+    void addToCell(int level, quint64 key, const QString& nodeId, double lat, double lon);
+    void removeFromCell(int level, quint64 key, const QString& nodeId, double lat, double lon);
+    void emitCell(int level, quint64 key, const Cell& cell, bool split, QVector<Item>& out) const;
+};
+
+#endif // NODE_CLUSTER_H
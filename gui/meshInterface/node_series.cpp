@@ -0,0 +1,303 @@
+#include "node_series.h"
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NODE_SERIES_SSE2 1
+#endif
+
+namespace {
+struct accumulator
+{
+    int count = 0;
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+    double sum = 0.0;
+};
+
+void accumulateScalar(const float* values, int n, accumulator& acc) {
+    for (int i = 0; i < n; ++i) {
+        float v = values[i];
+        if (std::isnan(v)) {
+            continue;
+        }
+        acc.min = qMin(acc.min, v);
+        acc.max = qMax(acc.max, v);
+        acc.sum += v;
+        acc.count++;
+    }
+}
+
+#ifdef NODE_SERIES_SSE2
+// Four lanes at a time; NaN lanes are masked to +inf/-inf/0 so they drop out of min/max/sum
+void accumulate(const float* values, int n, accumulator& acc) {
+    const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    const __m128 negInf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    __m128 vmin = inf;
+    __m128 vmax = negInf;
+    __m128 vsum = _mm_setzero_ps();
+    int count = 0;
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(values + i);
+        __m128 valid = _mm_cmpord_ps(v, v);
+        vmin = _mm_min_ps(vmin, _mm_or_ps(_mm_and_ps(valid, v), _mm_andnot_ps(valid, inf)));
+        vmax = _mm_max_ps(vmax, _mm_or_ps(_mm_and_ps(valid, v), _mm_andnot_ps(valid, negInf)));
+        vsum = _mm_add_ps(vsum, _mm_and_ps(valid, v));
+        int mask = _mm_movemask_ps(valid);
+        count += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, vmin);
+    acc.min = qMin(acc.min, qMin(qMin(lanes[0], lanes[1]), qMin(lanes[2], lanes[3])));
+    _mm_store_ps(lanes, vmax);
+    acc.max = qMax(acc.max, qMax(qMax(lanes[0], lanes[1]), qMax(lanes[2], lanes[3])));
+    _mm_store_ps(lanes, vsum);
+    acc.sum += double(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    acc.count += count;
+
+    accumulateScalar(values + i, n - i, acc);
+}
+#else
+void accumulate(const float* values, int n, accumulator& acc) {
+    accumulateScalar(values, n, acc);
+}
+#endif
+
+float columnValue(const mesh_event& event, int column) {
+    switch (column) {
+    case node_series::BatteryLevel: return event.batteryLevel < 0 ? NAN : float(event.batteryLevel);
+    case node_series::Voltage: return event.voltage;
+    case node_series::AirUtilTx: return event.airUtilTx;
+    case node_series::ChannelUtilization: return event.channelUtilization;
+    case node_series::RxSnr: return event.rxSnr;
+    case node_series::RxRssi: return event.rxRssi == 0 ? NAN : float(event.rxRssi);
+    default: return NAN;
+    }
+}
+}
+
+bool node_series::append(const mesh_event& event) {
+    QWriteLocker locker(&lock);
+    return insert(event);
+}
+
+int node_series::appendBatch(const QVector<mesh_event>& events) {
+    QWriteLocker locker(&lock);
+    int appended = 0;
+    for (const mesh_event& event : events) {
+        appended += insert(event) ? 1 : 0;
+    }
+    return appended;
+}
+
+bool node_series::insert(const mesh_event& event) {
+    if (event.from == 0) {
+        return false;
+    }
+
+    float row[ColumnCount];
+    bool any = false;
+    for (int c = 0; c < ColumnCount; ++c) {
+        row[c] = columnValue(event, c);
+        any = any || !std::isnan(row[c]);
+    }
+    if (!any) {
+        return false;
+    }
+
+    Series& s = series[event.from];
+
+    // Timestamps must stay sorted for the window search, a late event takes the last time seen
+    qint64 timestamp = event.timestampMs;
+    if (s.rows > 0) {
+        timestamp = qMax(timestamp, s.chunks.back().lastTimestamp());
+    }
+
+    if (s.chunks.empty() || s.chunks.back().size == s.chunks.back().capacity) {
+        int capacity = FIRST_CHUNK_ROWS;
+        if (!s.chunks.empty()) {
+            capacity = qMin(s.chunks.back().capacity * 2, int(CHUNK_ROWS));
+        }
+        s.chunks.emplace_back(capacity);
+    }
+    Chunk& chunk = s.chunks.back();
+    chunk.timestamp[chunk.size] = timestamp;
+    for (int c = 0; c < ColumnCount; ++c) {
+        chunk.column(c)[chunk.size] = row[c];
+    }
+    chunk.size++;
+    s.rows++;
+
+    dropBefore(s, timestamp - maxAgeMs);
+    return true;
+}
+
+void node_series::dropBefore(Series& s, qint64 cutoffMs) {
+    size_t old = 0;
+    while (old + 1 < s.chunks.size() && s.chunks[old].lastTimestamp() < cutoffMs) {
+        s.rows -= s.chunks[old].size;
+        old++;
+    }
+    if (old > 0) {
+        s.chunks.erase(s.chunks.begin(), s.chunks.begin() + old);
+    }
+}
+
+void node_series::setMaxAge(qint64 ms) {
+    QWriteLocker locker(&lock);
+    maxAgeMs = ms;
+}
+
+void node_series::prune(qint64 nowMs) {
+    QWriteLocker locker(&lock);
+    qint64 cutoff = nowMs - maxAgeMs;
+    for (auto it = series.begin(); it != series.end();) {
+        Series& s = it->second;
+        if (s.rows == 0 || s.chunks.back().lastTimestamp() < cutoff) {
+            it = series.erase(it);
+            continue;
+        }
+        dropBefore(s, cutoff);
+        ++it;
+    }
+}
+
+void node_series::clear() {
+    QWriteLocker locker(&lock);
+    series.clear();
+}
+
+QVector<quint32> node_series::nodes() const {
+    QReadLocker locker(&lock);
+    QVector<quint32> result;
+    result.reserve(int(series.size()));
+    for (const auto& entry : series) {
+        result.append(entry.first);
+    }
+    return result;
+}
+
+int node_series::rowCount(quint32 node) const {
+    QReadLocker locker(&lock);
+    auto it = series.find(node);
+    return it == series.end() ? 0 : it->second.rows;
+}
+
+qint64 node_series::lastTimestamp(quint32 node) const {
+    QReadLocker locker(&lock);
+    auto it = series.find(node);
+    if (it == series.end() || it->second.rows == 0) {
+        return 0;
+    }
+    return it->second.chunks.back().lastTimestamp();
+}
+
+template <typename Visit>
+void node_series::forEachRun(const Series& s, Column column, qint64 fromMs, qint64 toMs, Visit visit) const {
+    // First chunk that can hold fromMs: the last one starting at or before it
+    auto chunkIt = std::upper_bound(s.chunks.begin(), s.chunks.end(), fromMs,
+                                    [](qint64 t, const Chunk& c) { return t < c.timestamp[0]; });
+    if (chunkIt != s.chunks.begin()) {
+        --chunkIt;
+    }
+
+    for (; chunkIt != s.chunks.end(); ++chunkIt) {
+        const Chunk& chunk = *chunkIt;
+        if (chunk.timestamp[0] > toMs) {
+            break;
+        }
+        const qint64* begin = chunk.timestamp.get();
+        const qint64* end = begin + chunk.size;
+        const qint64* lo = std::lower_bound(begin, end, fromMs);
+        const qint64* hi = std::upper_bound(lo, end, toMs);
+        if (hi > lo) {
+            visit(lo, chunk.column(column) + (lo - begin), int(hi - lo));
+        }
+    }
+}
+
+series_stats node_series::stats(quint32 node, Column column, qint64 fromMs, qint64 toMs) const {
+    series_stats result;
+    QReadLocker locker(&lock);
+    auto it = series.find(node);
+    if (it == series.end() || column < 0 || column >= ColumnCount) {
+        return result;
+    }
+
+    accumulator acc;
+    forEachRun(it->second, column, fromMs, toMs, [&acc](const qint64*, const float* values, int n) { accumulate(values, n, acc); });
+    if (acc.count > 0) {
+        result.count = acc.count;
+        result.min = acc.min;
+        result.max = acc.max;
+        result.mean = float(acc.sum / acc.count);
+    }
+    return result;
+}
+
+float node_series::percentile(quint32 node, Column column, qint64 fromMs, qint64 toMs, double p) const {
+    std::vector<float> window;
+    {
+        QReadLocker locker(&lock);
+        auto it = series.find(node);
+        if (it == series.end() || column < 0 || column >= ColumnCount) {
+            return NAN;
+        }
+        forEachRun(it->second, column, fromMs, toMs, [&window](const qint64*, const float* values, int n) {
+            for (int i = 0; i < n; ++i) {
+                if (!std::isnan(values[i])) {
+                    window.push_back(values[i]);
+                }
+            }
+        });
+    }
+    if (window.empty()) {
+        return NAN;
+    }
+
+    // Nearest-rank, selection instead of a full sort
+    p = qBound(0.0, p, 1.0);
+    size_t rank = size_t(p * (window.size() - 1) + 0.5);
+    std::nth_element(window.begin(), window.begin() + rank, window.end());
+    return window[rank];
+}
+
+QVector<float> node_series::bucketMeans(quint32 node, Column column, qint64 fromMs, qint64 bucketMs, int buckets) const {
+    QVector<float> means(qMax(0, buckets), NAN);
+    if (buckets <= 0 || bucketMs <= 0 || column < 0 || column >= ColumnCount) {
+        return means;
+    }
+    QVector<double> sums(buckets, 0.0);
+    QVector<int> counts(buckets, 0);
+    {
+        QReadLocker locker(&lock);
+        auto it = series.find(node);
+        if (it == series.end()) {
+            return means;
+        }
+        // One pass over the window, rows are sorted so the bucket index only moves forward
+        forEachRun(it->second, column, fromMs, fromMs + bucketMs * buckets - 1,
+                   [&](const qint64* timestamps, const float* values, int n) {
+            for (int i = 0; i < n; ++i) {
+                if (std::isnan(values[i])) {
+                    continue;
+                }
+                int bucket = int((timestamps[i] - fromMs) / bucketMs);
+                sums[bucket] += values[i];
+                counts[bucket]++;
+            }
+        });
+    }
+    for (int b = 0; b < buckets; ++b) {
+        if (counts[b] > 0) {
+            means[b] = float(sums[b] / counts[b]);
+        }
+    }
+    return means;
+}
@@ -0,0 +1,97 @@
+#ifndef NODE_SERIES_H
+#define NODE_SERIES_H
+
+#include <QReadWriteLock>
+#include <QVector>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "mesh_event.h"
+
+struct series_stats
+{
+    int count = 0;
+    float min = NAN;
+    float max = NAN;
+    float mean = NAN;
+};
+
+// Per-node metric history stored column by column (struct of arrays). Each node
+// owns a list of chunks that are only ever appended to, so a chunk's arrays never
+// move and window queries run straight over contiguous floats. A node's first chunk
+// is small and each new one doubles up to CHUNK_ROWS, so nodes heard a handful of
+// times stay cheap. Chunks holding nothing newer than the age cap are dropped whole.
+// Missing values are NaN and are skipped by every kernel.
+class node_series
+{
+public:
+    enum Column {
+        BatteryLevel,
+        Voltage,
+        AirUtilTx,
+        ChannelUtilization,
+        RxSnr,
+        RxRssi,
+        ColumnCount
+    };
+
+    static const int FIRST_CHUNK_ROWS = 32;
+    static const int CHUNK_ROWS = 1024;
+
+    node_series() = default;
+    node_series(const node_series&) = delete;
+    node_series& operator=(const node_series&) = delete;
+
+    // Returns false when the event carries none of the tracked metrics
+    bool append(const mesh_event& event);
+    // Same as append() for each event under a single lock, returns how many were kept
+    int appendBatch(const QVector<mesh_event>& events);
+    void clear();
+    void setMaxAge(qint64 ms);
+    // Drops chunks older than the age cap for every node, and nodes left with none
+    void prune(qint64 nowMs);
+
+    QVector<quint32> nodes() const;
+    int rowCount(quint32 node) const;
+    qint64 lastTimestamp(quint32 node) const;
+
+    // Window [fromMs, toMs] inclusive
+    series_stats stats(quint32 node, Column column, qint64 fromMs, qint64 toMs) const;
+    float percentile(quint32 node, Column column, qint64 fromMs, qint64 toMs, double p) const;
+    // Mean of each of `buckets` consecutive bucketMs-wide buckets from fromMs, NaN where empty
+    QVector<float> bucketMeans(quint32 node, Column column, qint64 fromMs, qint64 bucketMs, int buckets) const;
+
+private:
+    struct Chunk {
+        explicit Chunk(int capacity)
+            : capacity(capacity), timestamp(new qint64[capacity]), values(new float[size_t(capacity) * ColumnCount]) {}
+        const float* column(int c) const { return values.get() + size_t(c) * capacity; }
+        float* column(int c) { return values.get() + size_t(c) * capacity; }
+        qint64 lastTimestamp() const { return timestamp[size - 1]; }
+
+        int capacity;
+        int size = 0;
+        std::unique_ptr<qint64[]> timestamp;
+        std::unique_ptr<float[]> values;
+    };
+
+    struct Series {
+        std::vector<Chunk> chunks;
+        int rows = 0;
+    };
+
+    bool insert(const mesh_event& event);
+    // Drops whole chunks ending before cutoffMs, always keeping the one being filled
+    static void dropBefore(Series& s, qint64 cutoffMs);
+
+    mutable QReadWriteLock lock;
+    // Series are move-only (they own their chunks), which QHash doesn't support
+    std::unordered_map<quint32, Series> series;
+    qint64 maxAgeMs = 7LL * 24 * 60 * 60 * 1000;
+
+    // Calls visit(timestamps, values, count) for each contiguous run of the window
+    template <typename Visit>
+    void forEachRun(const Series& s, Column column, qint64 fromMs, qint64 toMs, Visit visit) const;
+};
+
+#endif // NODE_SERIES_H
@@ -0,0 +1,131 @@
+#include "node_snapshot.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+const quint32 SNAPSHOT_MAGIC = 0x534e4d4d; // "MMNS"
+const quint32 SNAPSHOT_VERSION = 1;
+const int SHORT_NAME_BYTES = 8;
+const int LONG_NAME_BYTES = 40;
+
+#pragma pack(push, 1)
+struct snapshot_header
+{
+    quint32 magic;
+    quint32 version;
+    quint32 recordSize;
+    quint32 count;
+};
+
+struct snapshot_record
+{
+    quint32 num;
+    qint64 lastHeardMs;
+    float snr;
+    qint32 rssi;
+    qint32 hops;
+    qint32 batteryLevel;
+    float voltage;
+    double latitude;
+    double longitude;
+    char shortName[SHORT_NAME_BYTES];
+    char longName[LONG_NAME_BYTES];
+};
+#pragma pack(pop)
+
+// Truncates on a character boundary so a cut name is still valid UTF-8
+void copyName(char* out, int size, const QString& name) {
+    std::memset(out, 0, size);
+    QByteArray utf8 = name.toUtf8();
+    int length = qMin<int>(utf8.size(), size);
+    while (length > 0 && length < utf8.size() && (uchar(utf8[length]) & 0xc0) == 0x80) {
+        length--;
+    }
+    std::memcpy(out, utf8.constData(), length);
+}
+
+QString readName(const char* in, int size) {
+    return QString::fromUtf8(in, qstrnlen(in, size));
+}
+}
+
+bool node_snapshot::save(const QString& fileName, const QVector<node_record>& nodes) {
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Node snapshot: could not open" << fileName << file.errorString();
+        return false;
+    }
+
+    QByteArray out(sizeof(snapshot_header) + nodes.size() * sizeof(snapshot_record), Qt::Uninitialized);
+    snapshot_header header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, sizeof(snapshot_record), quint32(nodes.size())};
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    char* p = out.data() + sizeof(header);
+    for (const node_record& node : nodes) {
+        snapshot_record record;
+        record.num = node.num;
+        record.lastHeardMs = node.lastHeardMs;
+        record.snr = node.snr;
+        record.rssi = node.rssi;
+        record.hops = node.hops;
+        record.batteryLevel = node.batteryLevel;
+        record.voltage = node.voltage;
+        record.latitude = node.latitude;
+        record.longitude = node.longitude;
+        copyName(record.shortName, SHORT_NAME_BYTES, node.shortName);
+        copyName(record.longName, LONG_NAME_BYTES, node.longName);
+        std::memcpy(p, &record, sizeof(record));
+        p += sizeof(record);
+    }
+
+    file.write(out);
+    return file.commit();
+}
+
+QVector<node_record> node_snapshot::load(const QString& fileName) {
+    QVector<node_record> nodes;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(snapshot_header))) {
+        return nodes;
+    }
+
+    const uchar* data = file.map(0, file.size());
+    if (!data) {
+        return nodes;
+    }
+
+    snapshot_header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.recordSize != sizeof(snapshot_record) ||
+        file.size() < qint64(sizeof(header) + quint64(header.count) * sizeof(snapshot_record))) {
+        qDebug() << "Node snapshot: ignoring incompatible file" << fileName;
+        file.unmap(const_cast<uchar*>(data));
+        return nodes;
+    }
+
+    nodes.reserve(header.count);
+    const uchar* p = data + sizeof(header);
+    for (quint32 i = 0; i < header.count; ++i, p += sizeof(snapshot_record)) {
+        snapshot_record record;
+        std::memcpy(&record, p, sizeof(record));
+        node_record node;
+        node.num = record.num;
+        node.lastHeardMs = record.lastHeardMs;
+        node.snr = record.snr;
+        node.rssi = record.rssi;
+        node.hops = record.hops;
+        node.batteryLevel = record.batteryLevel;
+        node.voltage = record.voltage;
+        node.latitude = record.latitude;
+        node.longitude = record.longitude;
+        node.shortName = readName(record.shortName, SHORT_NAME_BYTES);
+        node.longName = readName(record.longName, LONG_NAME_BYTES);
+        nodes.append(node);
+    }
+
+    file.unmap(const_cast<uchar*>(data));
+    return nodes;
+}
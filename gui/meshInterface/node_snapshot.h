@@ -0,0 +1,16 @@
+#ifndef NODE_SNAPSHOT_H
+#define NODE_SNAPSHOT_H
+
+#include <QString>
+#include <QVector>
+#include "node_table_model.h"
+
+// Compact checkpoint of the node table: a small header followed by one
+// fixed-size record per node, so loading is a single map and a linear copy.
+// Saved through QSaveFile, a crash mid-write leaves the previous snapshot intact.
+namespace node_snapshot {
+bool save(const QString& fileName, const QVector<node_record>& nodes);
+QVector<node_record> load(const QString& fileName);
+}
+
+#endif // NODE_SNAPSHOT_H
@@ -0,0 +1,186 @@
+#include "node_sort_proxy.h"
+#include <algorithm>
+
+node_sort_proxy::node_sort_proxy(QObject *parent)
+    : QAbstractProxyModel{parent}
+    , nodes(nullptr)
+    , sortColumn(-1)
+    , sortOrder(Qt::AscendingOrder)
+{
+}
+
+void node_sort_proxy::setSourceModel(QAbstractItemModel *sourceModel) {
+    beginResetModel();
+    if (nodes) {
+        disconnect(nodes, nullptr, this, nullptr);
+    }
+
+    QAbstractProxyModel::setSourceModel(sourceModel);
+    nodes = qobject_cast<node_table_model*>(sourceModel);
+
+    if (nodes) {
+        connect(nodes, &QAbstractItemModel::rowsInserted, this, &node_sort_proxy::onSourceRowsInserted);
+        connect(nodes, &QAbstractItemModel::dataChanged, this, &node_sort_proxy::onSourceDataChanged);
+        connect(nodes, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { beginResetModel(); });
+        connect(nodes, &QAbstractItemModel::modelReset, this, &node_sort_proxy::onSourceReset);
+    }
+    rebuild();
+    endResetModel();
+}
+
+QModelIndex node_sort_proxy::index(int row, int column, const QModelIndex &parent) const {
+    if (parent.isValid() || row < 0 || row >= proxyToSource.size() ||
+        column < 0 || column >= node_table_model::ColumnCount) {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+QModelIndex node_sort_proxy::parent(const QModelIndex &child) const {
+    Q_UNUSED(child);
+    return QModelIndex();
+}
+
+int node_sort_proxy::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : proxyToSource.size();
+}
+
+int node_sort_proxy::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : node_table_model::ColumnCount;
+}
+
+QVariant node_sort_proxy::headerData(int section, Qt::Orientation orientation, int role) const {
+    // Columns are never reordered, so headers come straight from the source even with no rows
+    if (orientation == Qt::Horizontal && nodes) {
+        return nodes->headerData(section, orientation, role);
+    }
+    return QAbstractProxyModel::headerData(section, orientation, role);
+}
+
+QModelIndex node_sort_proxy::mapToSource(const QModelIndex &proxyIndex) const {
+    if (!nodes || !proxyIndex.isValid() || proxyIndex.row() >= proxyToSource.size()) {
+        return QModelIndex();
+    }
+    return nodes->index(proxyToSource[proxyIndex.row()], proxyIndex.column());
+}
+
+QModelIndex node_sort_proxy::mapFromSource(const QModelIndex &sourceIndex) const {
+    if (!sourceIndex.isValid() || sourceIndex.row() >= sourceToProxy.size()) {
+        return QModelIndex();
+    }
+    return index(sourceToProxy[sourceIndex.row()], sourceIndex.column());
+}
+
+// Ties fall back to arrival order, which makes the ordering total and the sort stable
+bool node_sort_proxy::lessThan(int sourceA, int sourceB) const {
+    int result = sortColumn < 0 ? 0 : nodes->compare(sourceA, sourceB, sortColumn);
+    if (result == 0) {
+        return sourceA < sourceB;
+    }
+    return sortOrder == Qt::AscendingOrder ? result < 0 : result > 0;
+}
+
+void node_sort_proxy::reindex(int from, int to) {
+    for (int i = from; i <= to; ++i) {
+        sourceToProxy[proxyToSource[i]] = i;
+    }
+}
+
+void node_sort_proxy::rebuild() {
+    int count = nodes ? nodes->rowCount() : 0;
+    proxyToSource.resize(count);
+    sourceToProxy.resize(count);
+    for (int i = 0; i < count; ++i) {
+        proxyToSource[i] = i;
+    }
+    std::sort(proxyToSource.begin(), proxyToSource.end(), [this](int a, int b) { return lessThan(a, b); });
+    reindex(0, count - 1);
+}
+
+int node_sort_proxy::insertPosition(int sourceRow) const {
+    auto it = std::lower_bound(proxyToSource.constBegin(), proxyToSource.constEnd(), sourceRow,
+                               [this](int a, int b) { return lessThan(a, b); });
+    return static_cast<int>(it - proxyToSource.constBegin());
+}
+
+void node_sort_proxy::sort(int column, Qt::SortOrder order) {
+    if (!nodes) {
+        return;
+    }
+
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+    QModelIndexList oldPersistent = persistentIndexList();
+    QModelIndexList sourcePersistent;
+    for (const QModelIndex& proxyIndex : oldPersistent) {
+        sourcePersistent.append(mapToSource(proxyIndex));
+    }
+
+    sortColumn = column;
+    sortOrder = order;
+    rebuild();
+
+    QModelIndexList newPersistent;
+    for (const QModelIndex& sourceIndex : sourcePersistent) {
+        newPersistent.append(mapFromSource(sourceIndex));
+    }
+    changePersistentIndexList(oldPersistent, newPersistent);
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void node_sort_proxy::onSourceRowsInserted(const QModelIndex &parent, int first, int last) {
+    if (parent.isValid()) {
+        return;
+    }
+
+    sourceToProxy.resize(nodes->rowCount());
+    for (int row = first; row <= last; ++row) {
+        int pos = insertPosition(row);
+        beginInsertRows(QModelIndex(), pos, pos);
+        proxyToSource.insert(pos, row);
+        reindex(pos, proxyToSource.size() - 1);
+        endInsertRows();
+    }
+}
+
+void node_sort_proxy::onSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+    if (!topLeft.isValid() || !bottomRight.isValid()) {
+        return;
+    }
+    bool sortAffected = sortColumn >= topLeft.column() && sortColumn <= bottomRight.column();
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        int pos = sourceToProxy[row];
+        int size = proxyToSource.size();
+
+        if (sortAffected) {
+            // Everything but this row is still sorted, so search only the side it has to move to
+            if (pos > 0 && lessThan(row, proxyToSource[pos - 1])) {
+                auto it = std::lower_bound(proxyToSource.constBegin(), proxyToSource.constBegin() + pos, row,
+                                           [this](int a, int b) { return lessThan(a, b); });
+                int target = static_cast<int>(it - proxyToSource.constBegin());
+                beginMoveRows(QModelIndex(), pos, pos, QModelIndex(), target);
+                proxyToSource.remove(pos);
+                proxyToSource.insert(target, row);
+                reindex(target, pos);
+                endMoveRows();
+            } else if (pos + 1 < size && lessThan(proxyToSource[pos + 1], row)) {
+                auto it = std::lower_bound(proxyToSource.constBegin() + pos + 1, proxyToSource.constEnd(), row,
+                                           [this](int a, int b) { return lessThan(a, b); });
+                int target = static_cast<int>(it - proxyToSource.constBegin());
+                beginMoveRows(QModelIndex(), pos, pos, QModelIndex(), target);
+                proxyToSource.insert(target, row);
+                proxyToSource.remove(pos);
+                reindex(pos, target - 1);
+                endMoveRows();
+            }
+        }
+
+        int proxyRow = sourceToProxy[row];
+        emit dataChanged(index(proxyRow, topLeft.column()), index(proxyRow, bottomRight.column()), roles);
+    }
+}
+
+void node_sort_proxy::onSourceReset() {
+    rebuild();
+    endResetModel();
+}
@@ -0,0 +1,47 @@
+#ifndef NODE_SORT_PROXY_H
+#define NODE_SORT_PROXY_H
+
+#include <QAbstractProxyModel>
+#include <QVector>
+#include "node_table_model.h"
+
+// Sorted view of node_table_model that keeps itself sorted incrementally.
+// A changed row is moved to its new place with a binary search and a single
+// beginMoveRows, new rows are inserted in place; only clicking a header does a
+// full (stable) sort. Ties keep arrival order so rows don't jump around.
+class node_sort_proxy : public QAbstractProxyModel
+{
+    Q_OBJECT
+public:
+    explicit node_sort_proxy(QObject *parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+private slots:
+    void onSourceRowsInserted(const QModelIndex &parent, int first, int last);
+    void onSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles);
+    void onSourceReset();
+
+private:
+    node_table_model* nodes;
+    int sortColumn;
+    Qt::SortOrder sortOrder;
+    QVector<int> proxyToSource;
+    QVector<int> sourceToProxy;
+
+    bool lessThan(int sourceA, int sourceB) const;
+    int insertPosition(int sourceRow) const;
+    void rebuild();
+    void reindex(int from, int to);
+};
+
+#endif // NODE_SORT_PROXY_H
@@ -0,0 +1,243 @@
+#include "node_spatial_index.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const double DEG_TO_RAD = M_PI / 180.0;
+const double KM_PER_DEGREE = node_spatial_index::EARTH_RADIUS_KM * DEG_TO_RAD;
+
+// Into [-180, 180), Leaflet hands out unwrapped longitudes once the map is panned across the antimeridian
+double wrapLon(double lon) {
+    double wrapped = std::fmod(lon + 180.0, 360.0);
+    return (wrapped < 0 ? wrapped + 360.0 : wrapped) - 180.0;
+}
+
+bool nearerFirst(const node_spatial_index::Hit& a, const node_spatial_index::Hit& b) {
+    return a.distanceKm < b.distanceKm;
+}
+}
+
+int node_spatial_index::latIndex(double lat) {
+    return qBound(0, int(std::floor((lat + 90.0) / CELL_DEGREES)), LAT_CELLS - 1);
+}
+
+int node_spatial_index::lonIndex(double lon) {
+    int index = int(std::floor((lon + 180.0) / CELL_DEGREES)) % LON_CELLS;
+    return index < 0 ? index + LON_CELLS : index;
+}
+
+quint64 node_spatial_index::cellKey(int latCell, int lonCell) {
+    return (quint64(quint32(latCell)) << 32) | quint32(lonCell);
+}
+
+double node_spatial_index::distanceKm(double lat1, double lon1, double lat2, double lon2) {
+    double dLat = (lat2 - lat1) * DEG_TO_RAD;
+    double dLon = (lon2 - lon1) * DEG_TO_RAD;
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               std::cos(lat1 * DEG_TO_RAD) * std::cos(lat2 * DEG_TO_RAD) * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2.0 * EARTH_RADIUS_KM * std::asin(std::sqrt(qMin(1.0, a)));
+}
+
+bool node_spatial_index::update(quint32 node, double lat, double lon) {
+    if (std::isnan(lat) || std::isnan(lon)) {
+        return false;
+    }
+    quint64 cell = cellKey(latIndex(lat), lonIndex(lon));
+    auto it = nodes.find(node);
+    bool isNew = it == nodes.end();
+    if (isNew) {
+        it = nodes.insert(node, Entry());
+    } else if (it->cell != cell) {
+        QVector<quint32>& members = cells[it->cell];
+        members.removeOne(node);
+        if (members.isEmpty()) {
+            cells.remove(it->cell);
+        }
+    }
+    if (isNew || it->cell != cell) {
+        cells[cell].append(node);
+    }
+    it->lat = lat;
+    it->lon = lon;
+    it->cell = cell;
+    return isNew;
+}
+
+bool node_spatial_index::remove(quint32 node) {
+    auto it = nodes.find(node);
+    if (it == nodes.end()) {
+        return false;
+    }
+    QVector<quint32>& members = cells[it->cell];
+    members.removeOne(node);
+    if (members.isEmpty()) {
+        cells.remove(it->cell);
+    }
+    nodes.erase(it);
+    return true;
+}
+
+bool node_spatial_index::position(quint32 node, double& lat, double& lon) const {
+    auto it = nodes.constFind(node);
+    if (it == nodes.constEnd()) {
+        return false;
+    }
+    lat = it->lat;
+    lon = it->lon;
+    return true;
+}
+
+void node_spatial_index::clear() {
+    nodes.clear();
+    cells.clear();
+}
+
+void node_spatial_index::collect(int latCell, int lonCell, double lat, double lon, double radiusKm, QVector<Hit>& out) const {
+    auto cell = cells.constFind(cellKey(latCell, (lonCell % LON_CELLS + LON_CELLS) % LON_CELLS));
+    if (cell == cells.constEnd()) {
+        return;
+    }
+    for (quint32 node : cell.value()) {
+        const Entry& entry = nodes[node];
+        double d = distanceKm(lat, lon, entry.lat, entry.lon);
+        if (d <= radiusKm) {
+            out.append(Hit{node, entry.lat, entry.lon, d});
+        }
+    }
+}
+
+QVector<node_spatial_index::Hit> node_spatial_index::withinRadius(double lat, double lon, double radiusKm) const {
+    QVector<Hit> hits;
+    if (nodes.isEmpty() || radiusKm < 0) {
+        return hits;
+    }
+
+    // Bounding box in cells; the longitude span widens with latitude and covers everything near a pole
+    double dLat = radiusKm / KM_PER_DEGREE;
+    // A circle reaching over a pole covers every longitude
+    double polarLat = std::abs(lat) + dLat;
+    double dLon = polarLat >= 90.0 ? 180.0 : qMin(180.0, dLat / std::cos(polarLat * DEG_TO_RAD));
+    int latFrom = latIndex(lat - dLat);
+    int latTo = latIndex(lat + dLat);
+    int lonSpan = int(std::ceil(dLon / CELL_DEGREES));
+    int lonCenter = lonIndex(lon);
+    int lonCells = qMin(2 * lonSpan + 1, int(LON_CELLS));
+
+    // Large areas cost more in empty cells than checking every node
+    if (qint64(latTo - latFrom + 1) * lonCells > nodes.size()) {
+        for (auto it = nodes.constBegin(); it != nodes.constEnd(); ++it) {
+            double d = distanceKm(lat, lon, it->lat, it->lon);
+            if (d <= radiusKm) {
+                hits.append(Hit{it.key(), it->lat, it->lon, d});
+            }
+        }
+    } else {
+        int lonFirst = lonCells == LON_CELLS ? 0 : lonCenter - lonSpan;
+        for (int y = latFrom; y <= latTo; ++y) {
+            for (int x = 0; x < lonCells; ++x) {
+                collect(y, lonFirst + x, lat, lon, radiusKm, hits);
+            }
+        }
+    }
+    std::sort(hits.begin(), hits.end(), nearerFirst);
+    return hits;
+}
+
+QVector<node_spatial_index::Hit> node_spatial_index::nearest(double lat, double lon, int count) const {
+    QVector<Hit> hits;
+    if (count <= 0 || nodes.isEmpty()) {
+        return hits;
+    }
+    count = qMin(count, int(nodes.size()));
+
+    int latCenter = latIndex(lat);
+    int lonCenter = lonIndex(lon);
+    qint64 visited = 0;
+    for (int ring = 0;; ++ring) {
+        // Sparse or far-away nodes: past this many cells a plain scan is cheaper
+        if (visited > nodes.size()) {
+            hits.clear();
+            for (auto it = nodes.constBegin(); it != nodes.constEnd(); ++it) {
+                hits.append(Hit{it.key(), it->lat, it->lon, distanceKm(lat, lon, it->lat, it->lon)});
+            }
+            break;
+        }
+
+        int latFrom = qMax(0, latCenter - ring);
+        int latTo = qMin(LAT_CELLS - 1, latCenter + ring);
+        for (int y = latFrom; y <= latTo; ++y) {
+            if (y == latCenter - ring || y == latCenter + ring) {
+                for (int x = lonCenter - ring; x <= lonCenter + ring; ++x) {
+                    collect(y, x, lat, lon, INFINITY, hits);
+                }
+                visited += 2 * ring + 1;
+            } else {
+                collect(y, lonCenter - ring, lat, lon, INFINITY, hits);
+                collect(y, lonCenter + ring, lat, lon, INFINITY, hits);
+                visited += 2;
+            }
+        }
+
+        // Anything outside ring r is at least r cells away; cells narrow towards
+        // the poles, so the bound uses the width at the block's most polar edge
+        if (hits.size() >= count) {
+            double edgeLat = qMin(89.99, qMax(std::abs(latFrom * CELL_DEGREES - 90.0), std::abs((latTo + 1) * CELL_DEGREES - 90.0)));
+            double cellKm = CELL_DEGREES * KM_PER_DEGREE * std::cos(edgeLat * DEG_TO_RAD);
+            std::nth_element(hits.begin(), hits.begin() + (count - 1), hits.end(), nearerFirst);
+            if (hits[count - 1].distanceKm <= ring * cellKm) {
+                break;
+            }
+        }
+    }
+
+    std::nth_element(hits.begin(), hits.begin() + (count - 1), hits.end(), nearerFirst);
+    hits.resize(count);
+    std::sort(hits.begin(), hits.end(), nearerFirst);
+    return hits;
+}
+
+QVector<node_spatial_index::Hit> node_spatial_index::inViewport(double south, double west, double north, double east) const {
+    QVector<Hit> hits;
+    if (nodes.isEmpty() || south > north) {
+        return hits;
+    }
+    bool everyLon = east - west >= 360.0;
+    west = wrapLon(west);
+    east = wrapLon(east);
+    bool crosses = !everyLon && west > east;
+    auto inside = [&](const Entry& entry) {
+        double lon = wrapLon(entry.lon);
+        bool inLon = everyLon || (crosses ? (lon >= west || lon <= east) : (lon >= west && lon <= east));
+        return entry.lat >= south && entry.lat <= north && inLon;
+    };
+
+    int latFrom = latIndex(south);
+    int latTo = latIndex(north);
+    int lonFrom = everyLon ? 0 : lonIndex(west);
+    int lonTo = lonIndex(east);
+    int lonCells = everyLon ? LON_CELLS : (crosses ? LON_CELLS - lonFrom + lonTo + 1 : lonTo - lonFrom + 1);
+
+    if (qint64(latTo - latFrom + 1) * lonCells > nodes.size()) {
+        for (auto it = nodes.constBegin(); it != nodes.constEnd(); ++it) {
+            if (inside(it.value())) {
+                hits.append(Hit{it.key(), it->lat, it->lon, 0.0});
+            }
+        }
+        return hits;
+    }
+    for (int y = latFrom; y <= latTo; ++y) {
+        for (int x = 0; x < lonCells; ++x) {
+            auto cell = cells.constFind(cellKey(y, (lonFrom + x) % LON_CELLS));
+            if (cell == cells.constEnd()) {
+                continue;
+            }
+            for (quint32 node : cell.value()) {
+                const Entry& entry = nodes[node];
+                if (inside(entry)) {
+                    hits.append(Hit{node, entry.lat, entry.lon, 0.0});
+                }
+            }
+        }
+    }
+    return hits;
+}
@@ -0,0 +1,60 @@
+#ifndef NODE_SPATIAL_INDEX_H
+#define NODE_SPATIAL_INDEX_H
+
+#include <QHash>
+#include <QVector>
+
+// Latest position of every node in a uniform lat/lon grid (a fixed-precision
+// geohash: CELL_DEGREES per side, roughly 5.5 km north-south). A fix moves the
+// node between at most two cells, and every query only visits the cells its area
+// covers before the exact great-circle check. Nearest-N searches ring by ring
+// outward and stops once no unvisited cell can hold anything closer.
+class node_spatial_index
+{
+public:
+    static constexpr double CELL_DEGREES = 0.05;
+    static constexpr double EARTH_RADIUS_KM = 6371.0088;
+
+    struct Hit {
+        quint32 node = 0;
+        double lat = 0.0;
+        double lon = 0.0;
+        double distanceKm = 0.0;
+    };
+
+    // Returns true if the node was not indexed before
+    bool update(quint32 node, double lat, double lon);
+    bool remove(quint32 node);
+    bool position(quint32 node, double& lat, double& lon) const;
+    int size() const { return nodes.size(); }
+    void clear();
+
+    // Sorted nearest first
+    QVector<Hit> withinRadius(double lat, double lon, double radiusKm) const;
+    QVector<Hit> nearest(double lat, double lon, int count) const;
+    // Edges may be unwrapped (170..190) or wrapped with west greater than east, either way
+    // the box crosses the antimeridian; distanceKm is left at 0
+    QVector<Hit> inViewport(double south, double west, double north, double east) const;
+
+    static double distanceKm(double lat1, double lon1, double lat2, double lon2);
+
+private:
+    static const int LAT_CELLS = int(180.0 / CELL_DEGREES);
+    static const int LON_CELLS = int(360.0 / CELL_DEGREES);
+
+    struct Entry {
+        double lat = 0.0;
+        double lon = 0.0;
+        quint64 cell = 0;
+    };
+
+    QHash<quint32, Entry> nodes;
+    QHash<quint64, QVector<quint32>> cells;
+
+    static int latIndex(double lat);
+    static int lonIndex(double lon);
+    static quint64 cellKey(int latCell, int lonCell);
+    void collect(int latCell, int lonCell, double lat, double lon, double radiusKm, QVector<Hit>& out) const;
+};
+
+#endif // NODE_SPATIAL_INDEX_H
@@ -0,0 +1,379 @@
+#include "node_table_model.h"
+#include <QDateTime>
+#include <QColor>
+
+namespace {
+template <typename T>
+bool assignIfChanged(T& field, const T& value) {
+    if (field == value) {
+        return false;
+    }
+    field = value;
+    return true;
+}
+
+// NaN never compares equal, treat two unknowns as unchanged
+bool assignIfChanged(float& field, float value) {
+    if ((std::isnan(field) && std::isnan(value)) || field == value) {
+        return false;
+    }
+    field = value;
+    return true;
+}
+
+template <typename T>
+int compareValues(const T& a, const T& b) {
+    return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+// Unknown values always sort after known ones
+int compareFloats(double a, double b) {
+    bool aUnknown = std::isnan(a);
+    bool bUnknown = std::isnan(b);
+    if (aUnknown || bUnknown) {
+        return compareValues(aUnknown, bUnknown);
+    }
+    return compareValues(a, b);
+}
+
+int compareKnown(int a, int b, int unknown) {
+    if (a == unknown || b == unknown) {
+        return compareValues(a == unknown, b == unknown);
+    }
+    return compareValues(a, b);
+}
+}
+
+node_table_model::node_table_model(QObject *parent)
+    : QAbstractTableModel{parent}
+{
+}
+
+int node_table_model::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : nodes.size();
+}
+
+int node_table_model::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant node_table_model::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case IdColumn: return "ID";
+    case ShortNameColumn: return "Short";
+    case LongNameColumn: return "Name";
+    case LastHeardColumn: return "Last Heard";
+    case SnrColumn: return "SNR";
+    case RssiColumn: return "RSSI";
+    case LinkColumn: return "Link (15 min)";
+    case AirtimeColumn: return "Airtime (1 h)";
+    case HopsColumn: return "Hops";
+    case PathColumn: return "Path";
+    case BatteryColumn: return "Battery";
+    case VoltageColumn: return "Voltage";
+    case DrainColumn: return "Drain";
+    case PositionColumn: return "Position";
+    case RangeColumn: return "Range";
+    default: return QVariant();
+    }
+}
+
+QVariant node_table_model::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= nodes.size()) {
+        return QVariant();
+    }
+    const node_record& node = nodes[index.row()];
+
+    if (role == Qt::TextAlignmentRole && index.column() != LongNameColumn) {
+        return int(Qt::AlignCenter);
+    }
+    if (role == Qt::ForegroundRole && ((index.column() == DrainColumn && node.drainAnomalous)
+                                       || (index.column() == PathColumn && node.critical))) {
+        return QColor(255, 80, 80);
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case IdColumn:
+        return QString("!%1").arg(node.num, 8, 16, QChar('0'));
+    case ShortNameColumn:
+        // Firmware default short name is the last four hex digits of the node number
+        return node.shortName.isEmpty() ? QString("%1").arg(node.num & 0xffff, 4, 16, QChar('0')) : node.shortName;
+    case LongNameColumn:
+        return node.longName;
+    case LastHeardColumn:
+        return node.lastHeardMs > 0 ? QDateTime::fromMSecsSinceEpoch(node.lastHeardMs).toString("hh:mm:ss") : QString();
+    case SnrColumn:
+        return std::isnan(node.snr) ? QString() : QString::number(node.snr, 'f', 2);
+    case RssiColumn:
+        return node.rssi == 0 ? QString() : QString::number(node.rssi);
+    case LinkColumn:
+        // Smoothed SNR with the 10th..90th percentile spread of the window
+        if (std::isnan(node.snrAvg)) {
+            return QString();
+        }
+        return std::isnan(node.snrP10) ? QString("%1 dB").arg(node.snrAvg, 0, 'f', 1)
+                                       : QString("%1 dB [%2..%3]").arg(node.snrAvg, 0, 'f', 1)
+                                             .arg(node.snrP10, 0, 'f', 1).arg(node.snrP90, 0, 'f', 1);
+    case AirtimeColumn:
+        // Estimated from what we heard / what the node reports
+        if (std::isnan(node.airtimeEstimate) && std::isnan(node.airtimeReported)) {
+            return QString();
+        }
+        return QString("%1 / %2").arg(std::isnan(node.airtimeEstimate) ? QString("?") : QString("%1%").arg(node.airtimeEstimate, 0, 'f', 1),
+                                      std::isnan(node.airtimeReported) ? QString("?") : QString("%1%").arg(node.airtimeReported, 0, 'f', 1));
+    case HopsColumn:
+        return node.hops < 0 ? QString() : QString::number(node.hops);
+    case PathColumn: {
+        // Next hop on the cheapest known path, flagged when the node is a cut vertex
+        QString path;
+        if (node.pathHops == 1) {
+            path = "direct";
+        } else if (node.pathHops > 1) {
+            path = QString("via !%1, %2 hops").arg(node.nextHop, 8, 16, QChar('0')).arg(node.pathHops);
+        }
+        if (node.critical) {
+            path += path.isEmpty() ? "critical" : ", critical";
+        }
+        return path;
+    }
+    case BatteryColumn:
+        return node.batteryLevel < 0 ? QString() : QString("%1%").arg(node.batteryLevel);
+    case VoltageColumn:
+        return std::isnan(node.voltage) ? QString() : QString("%1V").arg(node.voltage, 0, 'f', 2);
+    case DrainColumn:
+        // Percent per hour and the hours left at that rate
+        if (node.externalPower) {
+            return QString("external");
+        }
+        if (std::isnan(node.drainPerHour)) {
+            return QString();
+        }
+        return std::isnan(node.hoursToEmpty) ? QString("%1%/h").arg(node.drainPerHour, 0, 'f', 2)
+                                             : QString("%1%/h, %2 h").arg(node.drainPerHour, 0, 'f', 2)
+                                                   .arg(node.hoursToEmpty, 0, 'f', node.hoursToEmpty < 10 ? 1 : 0);
+    case PositionColumn:
+        return node.hasPosition() ? QString("%1, %2").arg(node.latitude, 0, 'f', 5).arg(node.longitude, 0, 'f', 5) : QString();
+    case RangeColumn:
+        return std::isnan(node.distanceKm) ? QString()
+                                           : QString("%1 km %2°").arg(node.distanceKm, 0, 'f', node.distanceKm < 10 ? 2 : 1)
+                                                 .arg(qRound(node.bearingDeg) % 360);
+    default:
+        return QVariant();
+    }
+}
+
+int node_table_model::compare(int rowA, int rowB, int column) const {
+    const node_record& a = nodes[rowA];
+    const node_record& b = nodes[rowB];
+    switch (column) {
+    case IdColumn: return compareValues(a.num, b.num);
+    case ShortNameColumn: return a.shortName.compare(b.shortName, Qt::CaseInsensitive);
+    case LongNameColumn: return a.longName.compare(b.longName, Qt::CaseInsensitive);
+    case LastHeardColumn: return compareValues(a.lastHeardMs, b.lastHeardMs);
+    case SnrColumn: return compareFloats(a.snr, b.snr);
+    case RssiColumn: return compareKnown(a.rssi, b.rssi, 0);
+    case LinkColumn: return compareFloats(a.snrAvg, b.snrAvg);
+    case AirtimeColumn: return compareFloats(a.airtimeEstimate, b.airtimeEstimate);
+    case HopsColumn: return compareKnown(a.hops, b.hops, -1);
+    case PathColumn: return compareKnown(a.pathHops, b.pathHops, -1);
+    case BatteryColumn: return compareKnown(a.batteryLevel, b.batteryLevel, -1);
+    case VoltageColumn: return compareFloats(a.voltage, b.voltage);
+    case DrainColumn: return compareFloats(a.hoursToEmpty, b.hoursToEmpty);
+    case PositionColumn: return compareFloats(a.latitude, b.latitude);
+    case RangeColumn: return compareFloats(a.distanceKm, b.distanceKm);
+    default: return 0;
+    }
+}
+
+int node_table_model::ensureRow(quint32 num) {
+    auto it = rowOf.constFind(num);
+    if (it != rowOf.constEnd()) {
+        return it.value();
+    }
+
+    int row = nodes.size();
+    beginInsertRows(QModelIndex(), row, row);
+    node_record node;
+    node.num = num;
+    nodes.append(node);
+    rowOf.insert(num, row);
+    changes++;
+    endInsertRows();
+    return row;
+}
+
+// One dataChanged per run of adjacent changed columns
+void node_table_model::emitChanged(int row, quint32 changedColumns) {
+    if (changedColumns) {
+        changes++;
+    }
+    int column = 0;
+    while (column < ColumnCount) {
+        if (!(changedColumns & (1u << column))) {
+            column++;
+            continue;
+        }
+        int first = column;
+        while (column + 1 < ColumnCount && (changedColumns & (1u << (column + 1)))) {
+            column++;
+        }
+        emit dataChanged(index(row, first), index(row, column), {Qt::DisplayRole});
+        column++;
+    }
+}
+
+void node_table_model::updateFromEvent(const mesh_event& event) {
+    if (event.from == 0) {
+        return;
+    }
+
+    int row = ensureRow(event.from);
+    node_record& node = nodes[row];
+    quint32 changed = 0;
+
+    if (assignIfChanged(node.lastHeardMs, event.timestampMs)) {
+        changed |= 1u << LastHeardColumn;
+    }
+    if (event.hasSnr() && assignIfChanged(node.snr, event.rxSnr)) {
+        changed |= 1u << SnrColumn;
+    }
+    if (event.rxRssi != 0 && assignIfChanged(node.rssi, event.rxRssi)) {
+        changed |= 1u << RssiColumn;
+    }
+    if (event.hopStart >= 0 && event.hopLimit >= 0 &&
+        assignIfChanged(node.hops, qMax(0, event.hopStart - event.hopLimit))) {
+        changed |= 1u << HopsColumn;
+    }
+    if (event.batteryLevel >= 0 && assignIfChanged(node.batteryLevel, event.batteryLevel)) {
+        changed |= 1u << BatteryColumn;
+    }
+    if (!std::isnan(event.voltage) && assignIfChanged(node.voltage, event.voltage)) {
+        changed |= 1u << VoltageColumn;
+    }
+    if (event.hasPosition()) {
+        bool moved = assignIfChanged(node.latitude, event.latitude);
+        moved = assignIfChanged(node.longitude, event.longitude) || moved;
+        if (moved) {
+            changed |= 1u << PositionColumn;
+        }
+    }
+    if (!std::isnan(event.distanceKm)) {
+        bool moved = assignIfChanged(node.distanceKm, event.distanceKm);
+        moved = assignIfChanged(node.bearingDeg, event.bearingDeg) || moved;
+        if (moved) {
+            changed |= 1u << RangeColumn;
+        }
+    }
+
+    emitChanged(row, changed);
+}
+
+void node_table_model::updateNodeInfo(quint32 nodeNum, const QString& shortName, const QString& longName) {
+    if (nodeNum == 0) {
+        return;
+    }
+
+    int row = ensureRow(nodeNum);
+    node_record& node = nodes[row];
+    quint32 changed = 0;
+
+    if (!shortName.isEmpty() && assignIfChanged(node.shortName, shortName)) {
+        changed |= 1u << ShortNameColumn;
+    }
+    if (!longName.isEmpty() && assignIfChanged(node.longName, longName)) {
+        changed |= 1u << LongNameColumn;
+    }
+
+    emitChanged(row, changed);
+}
+
+void node_table_model::restore(const QVector<node_record>& records) {
+    beginResetModel();
+    nodes = records;
+    rowOf.clear();
+    for (int row = 0; row < nodes.size(); ++row) {
+        rowOf.insert(nodes[row].num, row);
+    }
+    endResetModel();
+}
+
+void node_table_model::updateLinkQuality(quint32 nodeNum, const link_summary& link) {
+    if (nodeNum == 0) {
+        return;
+    }
+
+    int row = ensureRow(nodeNum);
+    node_record& node = nodes[row];
+    bool changed = assignIfChanged(node.snrAvg, link.snr.ewma);
+    changed = assignIfChanged(node.snrP10, link.snr.p10) || changed;
+    changed = assignIfChanged(node.snrP90, link.snr.p90) || changed;
+    changed = assignIfChanged(node.rssiAvg, link.rssi.ewma) || changed;
+
+    emitChanged(row, changed ? 1u << LinkColumn : 0);
+}
+
+void node_table_model::updateAirtime(quint32 nodeNum, const airtime_check& airtime) {
+    if (nodeNum == 0) {
+        return;
+    }
+
+    int row = ensureRow(nodeNum);
+    node_record& node = nodes[row];
+    // Rounded to what's displayed so every packet doesn't repaint the cell
+    auto shown = [](double percent) { return std::isnan(percent) ? NAN : std::round(float(percent) * 10.0f) / 10.0f; };
+    bool changed = assignIfChanged(node.airtimeEstimate, shown(airtime.estimatedTxPercent));
+    changed = assignIfChanged(node.airtimeReported, shown(airtime.reportedTxPercent)) || changed;
+
+    emitChanged(row, changed ? 1u << AirtimeColumn : 0);
+}
+
+// Only for nodes already in the table, a position alone doesn't make a row
+void node_table_model::updateRange(quint32 nodeNum, float distanceKm, float bearingDeg) {
+    int row = rowForNode(nodeNum);
+    if (row < 0) {
+        return;
+    }
+    node_record& node = nodes[row];
+    bool changed = assignIfChanged(node.distanceKm, distanceKm);
+    changed = assignIfChanged(node.bearingDeg, bearingDeg) || changed;
+
+    emitChanged(row, changed ? 1u << RangeColumn : 0);
+}
+
+void node_table_model::updateBattery(quint32 nodeNum, const battery_estimate& battery) {
+    int row = rowForNode(nodeNum);
+    if (row < 0) {
+        return;
+    }
+    node_record& node = nodes[row];
+    // Rounded to what's displayed so every report doesn't repaint the cell
+    float hours = std::isnan(battery.hoursToEmpty) ? NAN
+                  : std::round(battery.hoursToEmpty * (battery.hoursToEmpty < 10 ? 10.0f : 1.0f))
+                        / (battery.hoursToEmpty < 10 ? 10.0f : 1.0f);
+    bool changed = assignIfChanged(node.drainPerHour, std::round(battery.drainPerHour * 100.0f) / 100.0f);
+    changed = assignIfChanged(node.hoursToEmpty, hours) || changed;
+    changed = assignIfChanged(node.externalPower, battery.externalPower) || changed;
+    changed = assignIfChanged(node.drainAnomalous, battery.anomalous) || changed;
+
+    emitChanged(row, changed ? 1u << DrainColumn : 0);
+}
+
+// Only for nodes already in the table, the path is empty when the node isn't reachable in the graph
+void node_table_model::updatePath(quint32 nodeNum, const QVector<quint32>& path, bool critical) {
+    int row = rowForNode(nodeNum);
+    if (row < 0) {
+        return;
+    }
+    node_record& node = nodes[row];
+    bool changed = assignIfChanged(node.pathHops, path.size() >= 2 ? int(path.size()) - 1 : -1);
+    changed = assignIfChanged(node.nextHop, path.size() > 2 ? path[1] : quint32(0)) || changed;
+    changed = assignIfChanged(node.critical, critical) || changed;
+
+    emitChanged(row, changed ? 1u << PathColumn : 0);
+}
@@ -0,0 +1,112 @@
+#ifndef NODE_TABLE_MODEL_H
+#define NODE_TABLE_MODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QVector>
+#include "mesh_event.h"
+#include "link_quality.h"
+#include "airtime_accounting.h"
+#include "battery_trend.h"
+
+struct node_record
+{
+    quint32 num = 0;
+    QString shortName;
+    QString longName;
+    qint64 lastHeardMs = 0;
+    float snr = NAN;
+    int rssi = 0;
+    int hops = -1;
+    int batteryLevel = -1;
+    float voltage = NAN;
+    double latitude = NAN;
+    double longitude = NAN;
+    // From link_quality, over its sliding window
+    float snrAvg = NAN;
+    float snrP10 = NAN;
+    float snrP90 = NAN;
+    float rssiAvg = NAN;
+    // From airtime_accounting: our estimate and the node's own air_util_tx, in percent
+    float airtimeEstimate = NAN;
+    float airtimeReported = NAN;
+    // From our own position, see range_bearing
+    float distanceKm = NAN;
+    float bearingDeg = NAN;
+    // From topology_graph: cheapest path from our radio, and whether losing this node splits the mesh
+    int pathHops = -1;
+    quint32 nextHop = 0;
+    bool critical = false;
+    // From battery_trend
+    float drainPerHour = NAN;
+    float hoursToEmpty = NAN;
+    bool externalPower = false;
+    bool drainAnomalous = false;
+
+    bool hasPosition() const { return !std::isnan(latitude) && !std::isnan(longitude); }
+};
+
+// One row per node heard on the mesh. Rows are only ever appended and every
+// update emits dataChanged for just the cells whose value changed, so views
+// (and node_sort_proxy) never have to reset.
+class node_table_model : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        IdColumn,
+        ShortNameColumn,
+        LongNameColumn,
+        LastHeardColumn,
+        SnrColumn,
+        RssiColumn,
+        LinkColumn,
+        AirtimeColumn,
+        HopsColumn,
+        PathColumn,
+        BatteryColumn,
+        VoltageColumn,
+        DrainColumn,
+        PositionColumn,
+        RangeColumn,
+        ColumnCount
+    };
+
+    explicit node_table_model(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Ordering used by node_sort_proxy, ties are left to the caller
+    int compare(int rowA, int rowB, int column) const;
+
+    int rowForNode(quint32 num) const { return rowOf.value(num, -1); }
+    const node_record& record(int row) const { return nodes[row]; }
+    const QVector<node_record>& records() const { return nodes; }
+    // Bumped on every change, lets the snapshot skip writing when nothing moved
+    quint64 revision() const { return changes; }
+
+    // Replaces all rows, used to restore the last snapshot before any packet arrives
+    void restore(const QVector<node_record>& records);
+
+public slots:
+    void updateFromEvent(const mesh_event& event);
+    void updateNodeInfo(quint32 nodeNum, const QString& shortName, const QString& longName);
+    void updateLinkQuality(quint32 nodeNum, const link_summary& link);
+    void updateAirtime(quint32 nodeNum, const airtime_check& airtime);
+    void updateRange(quint32 nodeNum, float distanceKm, float bearingDeg);
+    void updateBattery(quint32 nodeNum, const battery_estimate& battery);
+    void updatePath(quint32 nodeNum, const QVector<quint32>& path, bool critical);
+
+private:
+    QVector<node_record> nodes;
+    QHash<quint32, int> rowOf;
+    quint64 changes = 0;
+
+    int ensureRow(quint32 num);
+    void emitChanged(int row, quint32 changedColumns);
+};
+
+#endif // NODE_TABLE_MODEL_H
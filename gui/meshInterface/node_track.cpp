@@ -0,0 +1,160 @@
+#include "node_track.h"
+#include <QtMath>
+#include <QStack>
+#include <QPair>
+#include <algorithm>
+
+namespace {
+const double EARTH_RADIUS_M = 6371000.0;
+// Fixes closer than this to the previous point only refresh its timestamp
+const double MIN_MOVE_METERS = 5.0;
+const double START_TOLERANCE_METERS = 5.0;
+const int LOD_PIXELS = 2;
+
+// Local equirectangular projection, good enough for the short segments of a track
+void toMeters(const node_track::TrackPoint& origin, const node_track::TrackPoint& p, double& x, double& y) {
+    x = qDegreesToRadians(p.lon - origin.lon) * EARTH_RADIUS_M * std::cos(qDegreesToRadians(origin.lat));
+    y = qDegreesToRadians(p.lat - origin.lat) * EARTH_RADIUS_M;
+}
+
+double distanceMeters(const node_track::TrackPoint& a, const node_track::TrackPoint& b) {
+    double x, y;
+    toMeters(a, b, x, y);
+    return std::sqrt(x * x + y * y);
+}
+
+double segmentDistance(const node_track::TrackPoint& p, const node_track::TrackPoint& a, const node_track::TrackPoint& b) {
+    double bx, by, px, py;
+    toMeters(a, b, bx, by);
+    toMeters(a, p, px, py);
+    double len2 = bx * bx + by * by;
+    if (len2 <= 0.0) {
+        return std::sqrt(px * px + py * py);
+    }
+    double t = std::clamp((px * bx + py * by) / len2, 0.0, 1.0);
+    double dx = px - t * bx;
+    double dy = py - t * by;
+    return std::sqrt(dx * dx + dy * dy);
+}
+}
+
+node_track::node_track() {}
+
+bool node_track::addPoint(const QString& nodeId, double lat, double lon, qint64 timestampMs) {
+    Track& track = tracks[nodeId];
+
+    TrackPoint point;
+    point.lat = lat;
+    point.lon = lon;
+    point.timestampMs = timestampMs;
+
+    if (!track.points.isEmpty() && distanceMeters(track.points.last(), point) < MIN_MOVE_METERS) {
+        track.points.last().timestampMs = timestampMs;
+        return false;
+    }
+
+    track.points.append(point);
+    if (track.points.size() > MAX_POINTS) {
+        compact(track);
+    }
+    track.version++;
+    return true;
+}
+
+void node_track::removeNode(const QString& nodeId) {
+    tracks.remove(nodeId);
+}
+
+void node_track::clear() {
+    tracks.clear();
+}
+
+int node_track::pointCount(const QString& nodeId) const {
+    auto it = tracks.constFind(nodeId);
+    return it == tracks.constEnd() ? 0 : it->points.size();
+}
+
+quint64 node_track::version(const QString& nodeId) const {
+    auto it = tracks.constFind(nodeId);
+    return it == tracks.constEnd() ? 0 : it->version;
+}
+
+QVector<node_track::TrackPoint> node_track::points(const QString& nodeId) const {
+    return tracks.value(nodeId).points;
+}
+
+// Thin the older part of the track until the whole thing fits in half its budget again.
+// Runs once every MAX_POINTS / 2 fixes so the cost per fix stays constant.
+void node_track::compact(Track& track) {
+    int recent = qMin<int>(RECENT_POINTS, track.points.size());
+    int oldEnd = track.points.size() - recent;
+    int oldBudget = MAX_POINTS / 2 - recent;
+
+    QVector<TrackPoint> older;
+    double tolerance = START_TOLERANCE_METERS;
+    do {
+        older = douglasPeucker(track.points, 0, oldEnd, tolerance);
+        tolerance *= 2.0;
+    } while (older.size() > oldBudget);
+
+    older.reserve(MAX_POINTS + 1);
+    for (int i = oldEnd + 1; i < track.points.size(); ++i) {
+        older.append(track.points[i]);
+    }
+    track.points = older;
+}
+
+double node_track::metersPerPixel(int zoom, double lat) {
+    return 156543.03392 * std::cos(qDegreesToRadians(lat)) / std::pow(2.0, zoom);
+}
+
+QVector<node_track::TrackPoint> node_track::simplified(const QString& nodeId, int zoom) const {
+    auto it = tracks.constFind(nodeId);
+    if (it == tracks.constEnd() || it->points.size() < 3) {
+        return it == tracks.constEnd() ? QVector<TrackPoint>() : it->points;
+    }
+    double tolerance = metersPerPixel(zoom, it->points.last().lat) * LOD_PIXELS;
+    return douglasPeucker(it->points, 0, it->points.size() - 1, tolerance);
+}
+
+// Iterative Douglas-Peucker over points[first..last], endpoints are always kept
+QVector<node_track::TrackPoint> node_track::douglasPeucker(const QVector<TrackPoint>& points, int first, int last, double toleranceMeters) {
+    QVector<TrackPoint> out;
+    if (last <= first) {
+        if (first < points.size()) {
+            out.append(points[first]);
+        }
+        return out;
+    }
+
+    QVector<bool> keep(last - first + 1, false);
+    keep[0] = true;
+    keep[last - first] = true;
+
+    QStack<QPair<int, int>> ranges;
+    ranges.push(qMakePair(first, last));
+    while (!ranges.isEmpty()) {
+        QPair<int, int> range = ranges.pop();
+        double maxDistance = 0.0;
+        int index = -1;
+        for (int i = range.first + 1; i < range.second; ++i) {
+            double d = segmentDistance(points[i], points[range.first], points[range.second]);
+            if (d > maxDistance) {
+                maxDistance = d;
+                index = i;
+            }
+        }
+        if (index != -1 && maxDistance > toleranceMeters) {
+            keep[index - first] = true;
+            ranges.push(qMakePair(range.first, index));
+            ranges.push(qMakePair(index, range.second));
+        }
+    }
+
+    for (int i = first; i <= last; ++i) {
+        if (keep[i - first]) {
+            out.append(points[i]);
+        }
+    }
+    return out;
+}
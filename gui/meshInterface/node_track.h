@@ -0,0 +1,52 @@
+#ifndef NODE_TRACK_H
+#define NODE_TRACK_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Movement history for every node that reports a position.
+// Each track holds at most MAX_POINTS points: when it fills up the older part
+// is simplified with Douglas-Peucker (tolerance doubling until it fits) while
+// the newest points stay at full resolution, so following a mobile node for
+// days never grows memory past a fixed size per node.
+class node_track
+{
+public:
+    struct TrackPoint {
+        double lat = 0.0;
+        double lon = 0.0;
+        qint64 timestampMs = 0;
+    };
+
+    static constexpr int MAX_POINTS = 512;
+    static constexpr int RECENT_POINTS = 128;
+
+    node_track();
+
+    // Returns true if the point was stored (repeated fixes in place are folded together)
+    bool addPoint(const QString& nodeId, double lat, double lon, qint64 timestampMs);
+    void removeNode(const QString& nodeId);
+    void clear();
+
+    int pointCount(const QString& nodeId) const;
+    quint64 version(const QString& nodeId) const;
+    QVector<TrackPoint> points(const QString& nodeId) const;
+
+    // Track reduced to what is visible at the given map zoom level
+    QVector<TrackPoint> simplified(const QString& nodeId, int zoom) const;
+
+private:
+    struct Track {
+        QVector<TrackPoint> points;
+        quint64 version = 0;
+    };
+
+    QHash<QString, Track> tracks;
+
+    void compact(Track& track);
+    static double metersPerPixel(int zoom, double lat);
+    static QVector<TrackPoint> douglasPeucker(const QVector<TrackPoint>& points, int first, int last, double toleranceMeters);
+};
+
+#endif // NODE_TRACK_H
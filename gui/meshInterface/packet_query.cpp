@@ -0,0 +1,124 @@
+#include "packet_query.h"
+#include "db_connections.h"
+#include "packet_store.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <limits>
+
+packet_query::packet_query(const QString& databasePath, const packet_range& range)
+    : databasePath(databasePath)
+    , range(range)
+{
+    rewind();
+}
+
+void packet_query::rewind() {
+    lastTs = std::numeric_limits<qint64>::min();
+    lastId = std::numeric_limits<qint64>::min();
+    done = false;
+}
+
+void packet_query::close() {
+    QSqlDatabase db = database();
+    db_connections::close(db);
+}
+
+QSqlDatabase packet_query::database() {
+    return db_connections::open(packet_store::CONNECTION_NAME, databasePath);
+}
+
+// Equality columns first so SQLite picks the matching composite index
+QString packet_query::whereClause() const {
+    QString where;
+    if (range.hasNode) {
+        where += "from_node = ? AND ";
+    }
+    if (range.portnum >= 0) {
+        where += "portnum = ? AND ";
+    }
+    return where + "ts BETWEEN ? AND ?";
+}
+
+int packet_query::bindRange(QSqlQuery& query) const {
+    int i = 0;
+    if (range.hasNode) {
+        query.bindValue(i++, range.node);
+    }
+    if (range.portnum >= 0) {
+        query.bindValue(i++, range.portnum);
+    }
+    query.bindValue(i++, range.fromMs);
+    query.bindValue(i++, range.toMs);
+    return i;
+}
+
+qint64 packet_query::count() {
+    QSqlDatabase db = database();
+    QSqlQuery* query = db.isOpen() ? db_connections::prepared(db, "SELECT COUNT(*) FROM packets WHERE " + whereClause()) : nullptr;
+    if (!query) {
+        return -1;
+    }
+    bindRange(*query);
+    qint64 result = query->exec() && query->next() ? query->value(0).toLongLong() : -1;
+    query->finish();
+    return result;
+}
+
+bool packet_query::next(QVector<mesh_event>& page, int limit) {
+    page.clear();
+    if (done) {
+        return false;
+    }
+
+    QSqlDatabase db = database();
+    if (!db.isOpen()) {
+        done = true;
+        return false;
+    }
+    QString sql = "SELECT id, ts, kind, from_node, to_node, packet_id, portnum, channel, rx_snr, rx_rssi, "
+                  "hop_limit, hop_start, level, text, json FROM packets WHERE " + whereClause() +
+                  " AND (ts, id) > (?, ?) ORDER BY ts, id LIMIT ?";
+    QSqlQuery* query = db_connections::prepared(db, sql);
+    if (!query) {
+        done = true;
+        return false;
+    }
+
+    int i = bindRange(*query);
+    query->bindValue(i++, lastTs);
+    query->bindValue(i++, lastId);
+    query->bindValue(i++, limit);
+    if (!query->exec()) {
+        qDebug() << "Packet query failed:" << query->lastError().text();
+        done = true;
+        return false;
+    }
+
+    page.reserve(limit);
+    while (query->next()) {
+        mesh_event event;
+        lastId = query->value(0).toLongLong();
+        event.timestampMs = lastTs = query->value(1).toLongLong();
+        event.kind = mesh_event::Kind(query->value(2).toInt());
+        event.from = query->value(3).toUInt();
+        event.to = query->value(4).toUInt();
+        event.packetId = query->value(5).toUInt();
+        event.portnum = query->value(6).isNull() ? -1 : query->value(6).toInt();
+        event.channel = query->value(7).isNull() ? -1 : query->value(7).toInt();
+        event.rxSnr = query->value(8).isNull() ? NAN : query->value(8).toFloat();
+        event.rxRssi = query->value(9).toInt();
+        event.hopLimit = query->value(10).isNull() ? -1 : query->value(10).toInt();
+        event.hopStart = query->value(11).isNull() ? -1 : query->value(11).toInt();
+        event.level = query->value(12).toString();
+        event.text = query->value(13).toString();
+        event.json = query->value(14).toString().toUtf8();
+        page.append(event);
+    }
+    query->finish();
+
+    if (page.size() < limit) {
+        done = true;
+    }
+    return !page.isEmpty();
+}
@@ -0,0 +1,52 @@
+#ifndef PACKET_QUERY_H
+#define PACKET_QUERY_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QVector>
+#include "mesh_event.h"
+
+struct packet_range
+{
+    qint64 fromMs = 0;
+    qint64 toMs = 0;
+    bool hasNode = false;
+    quint32 node = 0;
+    int portnum = -1;
+};
+
+// Pages through the packet store's packets table in (ts, id) order using keyset
+// paging: each page continues after the last (ts, id) it returned, so every page
+// is an index range scan on (from_node, ts), (portnum, ts) or (ts) and nothing is
+// ever held beyond the current page. Reads go through this thread's own
+// connection (see db_connections), so a query can run on any thread while the
+// store keeps writing under WAL.
+class packet_query
+{
+public:
+    static const int PAGE_ROWS = 1000;
+
+    packet_query(const QString& databasePath, const packet_range& range);
+
+    // Fills page with up to limit rows, returns false once the range is exhausted
+    bool next(QVector<mesh_event>& page, int limit = PAGE_ROWS);
+    // Counted with the same index, used for progress
+    qint64 count();
+    void rewind();
+    // Closes this thread's connection, for threads that exist only to run the query
+    void close();
+
+private:
+    QString databasePath;
+    packet_range range;
+    qint64 lastTs;
+    qint64 lastId;
+    bool done = false;
+
+    QSqlDatabase database();
+    QString whereClause() const;
+    int bindRange(QSqlQuery& query) const;
+};
+
+#endif // PACKET_QUERY_H
@@ -0,0 +1,512 @@
+#include "packet_store.h"
+#include "db_connections.h"
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QHash>
+#include <algorithm>
+#include <QDebug>
+
+namespace {
+// Column names shared by the raw table and the rollup tables (as <name>_min, _max, _sum, _n)
+const char* METRIC_COLUMNS[packet_store::MetricCount] = {
+    "battery_level", "voltage", "air_util_tx", "channel_utilization"
+};
+
+const qint64 MINUTE_MS = 60 * 1000;
+const qint64 HOUR_MS = 60 * MINUTE_MS;
+const qint64 DAY_MS = 24 * HOUR_MS;
+
+double metricValue(const mesh_event& event, int metric) {
+    switch (metric) {
+    case packet_store::BatteryLevel: return event.batteryLevel < 0 ? NAN : event.batteryLevel;
+    case packet_store::Voltage: return event.voltage;
+    case packet_store::AirUtilTx: return event.airUtilTx;
+    case packet_store::ChannelUtilization: return event.channelUtilization;
+    default: return NAN;
+    }
+}
+
+struct rollup_acc
+{
+    double min[packet_store::MetricCount];
+    double max[packet_store::MetricCount];
+    double sum[packet_store::MetricCount] = {};
+    int count[packet_store::MetricCount] = {};
+
+    rollup_acc() {
+        std::fill(std::begin(min), std::end(min), INFINITY);
+        std::fill(std::begin(max), std::end(max), -INFINITY);
+    }
+
+    void add(const mesh_event& event) {
+        for (int m = 0; m < packet_store::MetricCount; ++m) {
+            double value = metricValue(event, m);
+            if (std::isnan(value)) {
+                continue;
+            }
+            min[m] = qMin(min[m], value);
+            max[m] = qMax(max[m], value);
+            sum[m] += value;
+            count[m]++;
+        }
+    }
+};
+
+QVariant optional(int value, int unknown) {
+    return value == unknown ? QVariant() : QVariant(value);
+}
+
+QVariant optional(double value) {
+    return std::isnan(value) ? QVariant() : QVariant(value);
+}
+
+QString joinNodes(const QVector<quint32>& nodes) {
+    QStringList ids;
+    for (quint32 node : nodes) {
+        ids.append(QString("!%1").arg(node, 8, 16, QChar('0')));
+    }
+    return ids.join(',');
+}
+
+QString joinSnrs(const QVector<float>& snrs) {
+    QStringList values;
+    for (float snr : snrs) {
+        values.append(std::isnan(snr) ? QString() : QString::number(snr, 'f', 2));
+    }
+    return values.join(',');
+}
+
+// Runs full statements of `rowsPerStatement` rows, then the remainder one row at a time
+template <typename Bind>
+bool insertRows(QSqlQuery& multi, QSqlQuery& single, int rowsPerStatement, int columns,
+                const QVector<const mesh_event*>& rows, Bind bind) {
+    int i = 0;
+    for (; i + rowsPerStatement <= rows.size(); i += rowsPerStatement) {
+        for (int r = 0; r < rowsPerStatement; ++r) {
+            bind(multi, r * columns, *rows[i + r]);
+        }
+        if (!multi.exec()) {
+            qDebug() << "Packet store insert failed:" << multi.lastError().text();
+            return false;
+        }
+    }
+    for (; i < rows.size(); ++i) {
+        bind(single, 0, *rows[i]);
+        if (!single.exec()) {
+            qDebug() << "Packet store insert failed:" << single.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+packet_store::packet_store(const QString& databasePath, QObject *parent)
+    : QObject{parent}
+    , databasePath(databasePath)
+    , flushTimer(nullptr)
+    , pruneTimer(nullptr)
+    , inserted(0)
+{
+    qRegisterMetaType<QVector<telemetry_point>>();
+    qRegisterMetaType<route_trace>();
+}
+
+packet_store::~packet_store() {
+    close();
+}
+
+bool packet_store::open() {
+    // The connection belongs to whichever thread opens it, so this has to run on the store thread
+    db = db_connections::open(CONNECTION_NAME, databasePath);
+    if (!db.isOpen()) {
+        qDebug() << "Failed to open packet store:" << db.lastError().text();
+        emit databaseError("Failed to open packet store: " + db.lastError().text());
+        return false;
+    }
+
+    if (!createTables() || !prepareStatements()) {
+        return false;
+    }
+
+    flushTimer = new QTimer(this);
+    flushTimer->setInterval(FLUSH_INTERVAL_MS);
+    connect(flushTimer, &QTimer::timeout, this, &packet_store::flush);
+    flushTimer->start();
+
+    pruneTimer = new QTimer(this);
+    pruneTimer->setInterval(PRUNE_INTERVAL_MS);
+    connect(pruneTimer, &QTimer::timeout, this, &packet_store::pruneRaw);
+    pruneTimer->start();
+    QTimer::singleShot(0, this, &packet_store::pruneRaw);
+    qDebug() << "Packet store opened:" << databasePath;
+    return true;
+}
+
+void packet_store::close() {
+    if (!db.isOpen()) {
+        return;
+    }
+    if (flushTimer) {
+        flushTimer->stop();
+        pruneTimer->stop();
+    }
+    flush();
+
+    insertPackets = insertPacket = insertTelemetryRows = insertTelemetryRow = nullptr;
+    upsertMinute = upsertHour = nullptr;
+    db_connections::close(db);
+}
+
+bool packet_store::createTables() {
+    QSqlQuery query(db);
+    QString createPackets = R"(
+        CREATE TABLE IF NOT EXISTS packets (
+            id INTEGER PRIMARY KEY,
+            ts INTEGER NOT NULL,
+            kind INTEGER NOT NULL,
+            from_node INTEGER,
+            to_node INTEGER,
+            packet_id INTEGER,
+            portnum INTEGER,
+            channel INTEGER,
+            rx_snr REAL,
+            rx_rssi INTEGER,
+            hop_limit INTEGER,
+            hop_start INTEGER,
+            level TEXT,
+            text TEXT,
+            json TEXT
+        )
+    )";
+    QString createTelemetry = R"(
+        CREATE TABLE IF NOT EXISTS telemetry (
+            ts INTEGER NOT NULL,
+            node INTEGER NOT NULL,
+            battery_level INTEGER,
+            voltage REAL,
+            air_util_tx REAL,
+            channel_utilization REAL
+        )
+    )";
+
+    // Paths are comma separated node ids, SNRs comma separated dB with empty entries for unknown
+    QString createTraceroutes = R"(
+        CREATE TABLE IF NOT EXISTS traceroutes (
+            ts INTEGER NOT NULL,
+            target INTEGER NOT NULL,
+            requester INTEGER,
+            request_id INTEGER,
+            rtt_ms INTEGER,
+            hops INTEGER NOT NULL,
+            route TEXT NOT NULL,
+            snr_towards TEXT,
+            route_back TEXT,
+            snr_back TEXT
+        )
+    )";
+
+    QString rollupColumns;
+    for (const char* metric : METRIC_COLUMNS) {
+        rollupColumns += QString("%1_min REAL, %1_max REAL, %1_sum REAL, %1_n INTEGER NOT NULL DEFAULT 0, ").arg(metric);
+    }
+    QString createRollup = "CREATE TABLE IF NOT EXISTS %1 (node INTEGER NOT NULL, bucket INTEGER NOT NULL, " +
+                           rollupColumns + "PRIMARY KEY (node, bucket)) WITHOUT ROWID";
+
+    if (!query.exec(createPackets) ||
+        !query.exec(createTelemetry) ||
+        !query.exec(createTraceroutes) ||
+        !query.exec(createRollup.arg("telemetry_1m")) ||
+        !query.exec(createRollup.arg("telemetry_1h")) ||
+        !query.exec("CREATE INDEX IF NOT EXISTS idx_packets_ts ON packets (ts)") ||
+        !query.exec("CREATE INDEX IF NOT EXISTS idx_packets_node_ts ON packets (from_node, ts)") ||
+        !query.exec("CREATE INDEX IF NOT EXISTS idx_packets_port_ts ON packets (portnum, ts)") ||
+        !query.exec("CREATE INDEX IF NOT EXISTS idx_telemetry_node_ts ON telemetry (node, ts)") ||
+        !query.exec("CREATE INDEX IF NOT EXISTS idx_telemetry_ts ON telemetry (ts)") ||
+        !query.exec("CREATE INDEX IF NOT EXISTS idx_telemetry_1m_bucket ON telemetry_1m (bucket)") ||
+        !query.exec("CREATE INDEX IF NOT EXISTS idx_traceroutes_target_ts ON traceroutes (target, ts)")) {
+        qDebug() << "Failed to create packet store tables:" << query.lastError().text();
+        emit databaseError("Failed to create packet store tables: " + query.lastError().text());
+        return false;
+    }
+    return true;
+}
+
+QString packet_store::insertSql(const char* table, const char* columns, int columnCount, int rows) {
+    QString row = "(" + QString("?,").repeated(columnCount - 1) + "?)";
+    QStringList values;
+    values.reserve(rows);
+    for (int i = 0; i < rows; ++i) {
+        values.append(row);
+    }
+    return QString("INSERT INTO %1 (%2) VALUES %3").arg(table, columns, values.join(','));
+}
+
+// Merges a pre-aggregated bucket into the stored one. SQLite's scalar min()/max()
+// return NULL if either side is NULL, hence the coalesce on both arguments.
+QString packet_store::upsertSql(const char* table) {
+    QStringList columns = {"node", "bucket"};
+    QStringList updates;
+    for (const char* metric : METRIC_COLUMNS) {
+        QString m(metric);
+        columns << m + "_min" << m + "_max" << m + "_sum" << m + "_n";
+        updates << QString("%1_min = min(coalesce(%1_min, excluded.%1_min), coalesce(excluded.%1_min, %1_min))").arg(m)
+                << QString("%1_max = max(coalesce(%1_max, excluded.%1_max), coalesce(excluded.%1_max, %1_max))").arg(m)
+                << QString("%1_sum = coalesce(%1_sum, 0) + coalesce(excluded.%1_sum, 0)").arg(m)
+                << QString("%1_n = %1_n + excluded.%1_n").arg(m);
+    }
+    return QString("INSERT INTO %1 (%2) VALUES (%3) ON CONFLICT (node, bucket) DO UPDATE SET %4")
+        .arg(table, columns.join(", "), QString("?,").repeated(columns.size() - 1) + "?", updates.join(", "));
+}
+
+bool packet_store::prepareStatements() {
+    const char* packetColumns = "ts, kind, from_node, to_node, packet_id, portnum, channel, "
+                                "rx_snr, rx_rssi, hop_limit, hop_start, level, text, json";
+    const char* telemetryColumns = "ts, node, battery_level, voltage, air_util_tx, channel_utilization";
+
+    insertPackets = db_connections::prepared(db, insertSql("packets", packetColumns, PACKET_COLUMNS, ROWS_PER_STATEMENT));
+    insertPacket = db_connections::prepared(db, insertSql("packets", packetColumns, PACKET_COLUMNS, 1));
+    insertTelemetryRows = db_connections::prepared(db, insertSql("telemetry", telemetryColumns, TELEMETRY_COLUMNS, ROWS_PER_STATEMENT));
+    insertTelemetryRow = db_connections::prepared(db, insertSql("telemetry", telemetryColumns, TELEMETRY_COLUMNS, 1));
+    upsertMinute = db_connections::prepared(db, upsertSql("telemetry_1m"));
+    upsertHour = db_connections::prepared(db, upsertSql("telemetry_1h"));
+
+    if (!insertPackets || !insertPacket || !insertTelemetryRows || !insertTelemetryRow || !upsertMinute || !upsertHour) {
+        emit databaseError("Failed to prepare packet store statements");
+        return false;
+    }
+    return true;
+}
+
+void packet_store::bindPacket(QSqlQuery& query, int offset, const mesh_event& event) {
+    query.bindValue(offset + 0, event.timestampMs);
+    query.bindValue(offset + 1, static_cast<int>(event.kind));
+    query.bindValue(offset + 2, event.from ? QVariant(event.from) : QVariant());
+    query.bindValue(offset + 3, event.to ? QVariant(event.to) : QVariant());
+    query.bindValue(offset + 4, event.packetId ? QVariant(event.packetId) : QVariant());
+    query.bindValue(offset + 5, optional(event.portnum, -1));
+    query.bindValue(offset + 6, optional(event.channel, -1));
+    query.bindValue(offset + 7, optional(event.rxSnr));
+    query.bindValue(offset + 8, optional(event.rxRssi, 0));
+    query.bindValue(offset + 9, optional(event.hopLimit, -1));
+    query.bindValue(offset + 10, optional(event.hopStart, -1));
+    query.bindValue(offset + 11, event.level);
+    query.bindValue(offset + 12, event.text.isEmpty() ? QVariant() : QVariant(event.text));
+    query.bindValue(offset + 13, QString::fromUtf8(event.json));
+}
+
+void packet_store::bindTelemetry(QSqlQuery& query, int offset, const mesh_event& event) {
+    query.bindValue(offset + 0, event.timestampMs);
+    query.bindValue(offset + 1, event.from);
+    query.bindValue(offset + 2, optional(event.batteryLevel, -1));
+    query.bindValue(offset + 3, optional(event.voltage));
+    query.bindValue(offset + 4, optional(event.airUtilTx));
+    query.bindValue(offset + 5, optional(event.channelUtilization));
+}
+
+void packet_store::append(const mesh_event& event) {
+    QMutexLocker locker(&mutex);
+    pending.append(event);
+    // Don't wait for the timer once a full batch is waiting
+    if (pending.size() >= FLUSH_ROWS && !flushQueued) {
+        flushQueued = true;
+        QMetaObject::invokeMethod(this, &packet_store::flush, Qt::QueuedConnection);
+    }
+}
+
+// Traceroutes arrive a few times an hour at most, so they're written straight away
+void packet_store::appendRoute(const route_trace& trace) {
+    if (!db.isOpen()) {
+        return;
+    }
+    QSqlQuery* query = db_connections::prepared(db,
+        "INSERT INTO traceroutes (ts, target, requester, request_id, rtt_ms, hops, route, snr_towards, route_back, snr_back) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    if (!query) {
+        return;
+    }
+    query->bindValue(0, trace.timestampMs);
+    query->bindValue(1, trace.target);
+    query->bindValue(2, trace.requester ? QVariant(trace.requester) : QVariant());
+    query->bindValue(3, trace.requestId ? QVariant(trace.requestId) : QVariant());
+    query->bindValue(4, trace.rttMs >= 0 ? QVariant(trace.rttMs) : QVariant());
+    query->bindValue(5, trace.hops());
+    query->bindValue(6, joinNodes(trace.forward));
+    query->bindValue(7, joinSnrs(trace.snrTowards));
+    query->bindValue(8, trace.hasBack() ? QVariant(joinNodes(trace.back)) : QVariant());
+    query->bindValue(9, trace.hasBack() ? QVariant(joinSnrs(trace.snrBack)) : QVariant());
+    if (!query->exec()) {
+        qDebug() << "Traceroute insert failed:" << query->lastError().text();
+        emit databaseError("Traceroute insert failed: " + query->lastError().text());
+    }
+}
+
+void packet_store::flush() {
+    QVector<mesh_event> batch;
+    {
+        QMutexLocker locker(&mutex);
+        batch.swap(pending);
+        flushQueued = false;
+    }
+    if (batch.isEmpty() || !db.isOpen()) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<const mesh_event*> packets;
+    QVector<const mesh_event*> telemetry;
+    packets.reserve(batch.size());
+    for (const mesh_event& event : batch) {
+        packets.append(&event);
+        if (event.kind == mesh_event::Telemetry && event.from != 0) {
+            telemetry.append(&event);
+        }
+    }
+
+    db.transaction();
+    bool ok = insertRows(*insertPackets, *insertPacket, ROWS_PER_STATEMENT, PACKET_COLUMNS, packets, bindPacket) &&
+              insertRows(*insertTelemetryRows, *insertTelemetryRow, ROWS_PER_STATEMENT, TELEMETRY_COLUMNS, telemetry, bindTelemetry) &&
+              updateRollups(telemetry);
+    if (!ok || !db.commit()) {
+        db.rollback();
+        emit databaseError("Packet store write failed: " + db.lastError().text());
+        return;
+    }
+
+    inserted += batch.size();
+    emit flushed(batch.size(), timer.nsecsElapsed() / 1000);
+}
+
+// Aggregates the batch per (node, bucket) first, so each touched bucket costs one upsert
+bool packet_store::updateRollups(const QVector<const mesh_event*>& telemetry) {
+    if (telemetry.isEmpty()) {
+        return true;
+    }
+
+    struct Tier {
+        QSqlQuery* query;
+        qint64 bucketMs;
+        QHash<QPair<quint32, qint64>, rollup_acc> buckets;
+    };
+    Tier tiers[] = {{upsertMinute, MINUTE_MS, {}}, {upsertHour, HOUR_MS, {}}};
+
+    for (const mesh_event* event : telemetry) {
+        for (Tier& tier : tiers) {
+            qint64 bucket = event->timestampMs - event->timestampMs % tier.bucketMs;
+            tier.buckets[qMakePair(event->from, bucket)].add(*event);
+        }
+    }
+
+    for (Tier& tier : tiers) {
+        for (auto it = tier.buckets.constBegin(); it != tier.buckets.constEnd(); ++it) {
+            QSqlQuery& query = *tier.query;
+            const rollup_acc& acc = it.value();
+            query.bindValue(0, it.key().first);
+            query.bindValue(1, it.key().second);
+            for (int m = 0; m < MetricCount; ++m) {
+                bool any = acc.count[m] > 0;
+                query.bindValue(2 + m * 4, any ? QVariant(acc.min[m]) : QVariant());
+                query.bindValue(3 + m * 4, any ? QVariant(acc.max[m]) : QVariant());
+                query.bindValue(4 + m * 4, any ? QVariant(acc.sum[m]) : QVariant());
+                query.bindValue(5 + m * 4, acc.count[m]);
+            }
+            if (!query.exec()) {
+                qDebug() << "Packet store rollup failed:" << query.lastError().text();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Raw samples and minute rollups past their retention are deleted a few thousand
+// rows at a time so a large backlog never holds the write lock for long
+void packet_store::pruneRaw() {
+    if (!db.isOpen()) {
+        return;
+    }
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const QPair<QString, qint64> targets[] = {
+        {"DELETE FROM telemetry WHERE rowid IN (SELECT rowid FROM telemetry WHERE ts < ? LIMIT ?)",
+         now - RAW_RETENTION_DAYS * DAY_MS},
+        {"DELETE FROM telemetry_1m WHERE (node, bucket) IN "
+         "(SELECT node, bucket FROM telemetry_1m WHERE bucket < ? LIMIT ?)",
+         now - MINUTE_RETENTION_DAYS * DAY_MS},
+        {"DELETE FROM traceroutes WHERE rowid IN (SELECT rowid FROM traceroutes WHERE ts < ? LIMIT ?)",
+         now - MINUTE_RETENTION_DAYS * DAY_MS},
+    };
+
+    for (const auto& target : targets) {
+        QSqlQuery* query = db_connections::prepared(db, target.first);
+        if (!query) {
+            return;
+        }
+        int deleted;
+        do {
+            query->bindValue(0, target.second);
+            query->bindValue(1, PRUNE_BATCH_ROWS);
+            if (!query->exec()) {
+                qDebug() << "Packet store prune failed:" << query->lastError().text();
+                return;
+            }
+            deleted = query->numRowsAffected();
+        } while (deleted == PRUNE_BATCH_ROWS);
+    }
+}
+
+QVector<telemetry_point> packet_store::telemetrySeries(quint32 node, Metric metric, qint64 fromMs, qint64 toMs) {
+    QVector<telemetry_point> points;
+    if (!db.isOpen() || metric < 0 || metric >= MetricCount) {
+        return points;
+    }
+
+    // Pick the tier from the span asked for and from what each tier still holds
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 span = toMs - fromMs;
+    const char* table = nullptr;
+    qint64 bucketMs = 1;
+    if (fromMs < now - MINUTE_RETENTION_DAYS * DAY_MS || span > 7 * DAY_MS) {
+        table = "telemetry_1h";
+        bucketMs = HOUR_MS;
+    } else if (fromMs < now - RAW_RETENTION_DAYS * DAY_MS || span > 6 * HOUR_MS) {
+        table = "telemetry_1m";
+        bucketMs = MINUTE_MS;
+    }
+
+    // Only eight distinct statements (tier x metric), each prepared once per connection
+    QString column(METRIC_COLUMNS[metric]);
+    QString sql = table ? QString("SELECT bucket, %1_min, %1_max, %1_sum / %1_n FROM %2 "
+                                  "WHERE node = ? AND bucket BETWEEN ? AND ? AND %1_n > 0 ORDER BY bucket").arg(column, table)
+                        : QString("SELECT ts, %1, %1, %1 FROM telemetry "
+                                  "WHERE node = ? AND ts BETWEEN ? AND ? AND %1 IS NOT NULL ORDER BY ts").arg(column);
+    QSqlQuery* query = db_connections::prepared(db, sql);
+    if (!query) {
+        return points;
+    }
+    query->bindValue(0, node);
+    // Include the bucket that fromMs falls into
+    query->bindValue(1, fromMs - fromMs % bucketMs);
+    query->bindValue(2, toMs);
+    if (!query->exec()) {
+        qDebug() << "Telemetry query failed:" << query->lastError().text();
+        return points;
+    }
+
+    while (query->next()) {
+        telemetry_point point;
+        point.timestampMs = query->value(0).toLongLong();
+        point.min = query->value(1).toDouble();
+        point.max = query->value(2).toDouble();
+        point.avg = query->value(3).toDouble();
+        points.append(point);
+    }
+    query->finish();
+    return points;
+}
+
+void packet_store::requestTelemetrySeries(int requestId, quint32 node, int metric, qint64 fromMs, qint64 toMs) {
+    emit telemetrySeriesReady(requestId, telemetrySeries(node, static_cast<Metric>(metric), fromMs, toMs));
+}
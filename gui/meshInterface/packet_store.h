@@ -0,0 +1,109 @@
+#ifndef PACKET_STORE_H
+#define PACKET_STORE_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
+#include <atomic>
+#include "mesh_event.h"
+#include "route_trace.h"
+
+struct telemetry_point
+{
+    qint64 timestampMs = 0;
+    double min = NAN;
+    double max = NAN;
+    double avg = NAN;
+};
+
+Q_DECLARE_METATYPE(QVector<telemetry_point>)
+
+// Persists every event (plus telemetry readings and traceroutes separately) in SQLite. Lives on
+// its own thread with its own connection from db_connections; append() can be called from any
+// thread and only queues the event. Rows are written in one transaction every
+// FLUSH_INTERVAL_MS or as soon as FLUSH_ROWS are waiting, using prepared
+// multi-row INSERTs so each statement carries ROWS_PER_STATEMENT rows.
+//
+// Telemetry is kept in three tiers: raw samples for RAW_RETENTION_DAYS, then
+// 1-minute and 1-hour min/max/avg rollups. Rollups are upserted from each
+// flushed batch so they never need a scan of the raw table, and telemetrySeries()
+// picks the coarsest tier that still gives enough points for the requested range.
+class packet_store : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr const char* CONNECTION_NAME = "packet_store";
+
+    explicit packet_store(const QString& databasePath, QObject *parent = nullptr);
+    ~packet_store();
+
+    enum Metric {
+        BatteryLevel,
+        Voltage,
+        AirUtilTx,
+        ChannelUtilization,
+        MetricCount
+    };
+
+    quint64 insertedCount() const { return inserted.load(); }
+
+    // Must be called on the store thread, other threads use requestTelemetrySeries()
+    QVector<telemetry_point> telemetrySeries(quint32 node, Metric metric, qint64 fromMs, qint64 toMs);
+
+public slots:
+    // Called once the object has been moved to its thread
+    bool open();
+    void close();
+    void append(const mesh_event& event);
+    void appendRoute(const route_trace& trace);
+    void flush();
+    void pruneRaw();
+    void requestTelemetrySeries(int requestId, quint32 node, int metric, qint64 fromMs, qint64 toMs);
+
+signals:
+    void flushed(int rows, qint64 elapsedUs);
+    void telemetrySeriesReady(int requestId, const QVector<telemetry_point>& points);
+    void databaseError(const QString& error);
+
+private:
+    static const int FLUSH_INTERVAL_MS = 250;
+    static const int FLUSH_ROWS = 2048;
+    static const int ROWS_PER_STATEMENT = 64;
+    static const int PACKET_COLUMNS = 14;
+    static const int TELEMETRY_COLUMNS = 6;
+    static const int RAW_RETENTION_DAYS = 7;
+    static const int MINUTE_RETENTION_DAYS = 90;
+    static const int PRUNE_INTERVAL_MS = 60 * 60 * 1000;
+    static const int PRUNE_BATCH_ROWS = 5000;
+
+    QString databasePath;
+    QSqlDatabase db;
+    QTimer* flushTimer;
+    QTimer* pruneTimer;
+
+    QMutex mutex;
+    QVector<mesh_event> pending;
+    bool flushQueued = false;
+    std::atomic<quint64> inserted;
+
+    // Owned by the connection's statement cache (db_connections)
+    QSqlQuery* insertPackets = nullptr;
+    QSqlQuery* insertPacket = nullptr;
+    QSqlQuery* insertTelemetryRows = nullptr;
+    QSqlQuery* insertTelemetryRow = nullptr;
+    QSqlQuery* upsertMinute = nullptr;
+    QSqlQuery* upsertHour = nullptr;
+
+    bool createTables();
+    bool prepareStatements();
+    static QString insertSql(const char* table, const char* columns, int columnCount, int rows);
+    static void bindPacket(QSqlQuery& query, int offset, const mesh_event& event);
+    static void bindTelemetry(QSqlQuery& query, int offset, const mesh_event& event);
+    static QString upsertSql(const char* table);
+    bool updateRollups(const QVector<const mesh_event*>& telemetry);
+};
+
+#endif // PACKET_STORE_H
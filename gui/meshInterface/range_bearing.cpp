@@ -0,0 +1,192 @@
+#include "range_bearing.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RANGE_BEARING_SSE2 1
+#endif
+
+namespace {
+const double EARTH_RADIUS_KM = 6371.0088;
+const double DEG_TO_RAD = M_PI / 180.0;
+const double RAD_TO_DEG = 180.0 / M_PI;
+
+#ifdef RANGE_BEARING_SSE2
+inline __m128d select(__m128d mask, __m128d a, __m128d b) {
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+inline __m128d absolute(__m128d v) {
+    return _mm_andnot_pd(_mm_set1_pd(-0.0), v);
+}
+
+// asin on [0, 1]: the odd Taylor series below 0.05 (the first omitted term is
+// under 1e-13 there) and Abramowitz & Stegun 4.4.46 above it (|error| <= 2e-8)
+inline __m128d asinPositive(__m128d v) {
+    __m128d v2 = _mm_mul_pd(v, v);
+    __m128d series = _mm_set1_pd(5.0 / 112.0);
+    series = _mm_add_pd(_mm_mul_pd(series, v2), _mm_set1_pd(3.0 / 40.0));
+    series = _mm_add_pd(_mm_mul_pd(series, v2), _mm_set1_pd(1.0 / 6.0));
+    series = _mm_add_pd(_mm_mul_pd(series, v2), _mm_set1_pd(1.0));
+    series = _mm_mul_pd(series, v);
+
+    const double a[] = {1.5707963050, -0.2145988016, 0.0889789874, -0.0501743046,
+                        0.0308918810, -0.0170881256, 0.0066700901, -0.0012624911};
+    __m128d poly = _mm_set1_pd(a[7]);
+    for (int i = 6; i >= 0; --i) {
+        poly = _mm_add_pd(_mm_mul_pd(poly, v), _mm_set1_pd(a[i]));
+    }
+    __m128d root = _mm_sqrt_pd(_mm_sub_pd(_mm_set1_pd(1.0), v));
+    __m128d large = _mm_sub_pd(_mm_set1_pd(M_PI / 2), _mm_mul_pd(root, poly));
+
+    return select(_mm_cmplt_pd(v, _mm_set1_pd(0.05)), series, large);
+}
+
+// atan2 from a minimax atan on [0, 1] (|error| around 1e-7 rad) and octant fix-ups
+inline __m128d atan2Approx(__m128d yv, __m128d xv) {
+    __m128d ay = absolute(yv);
+    __m128d ax = absolute(xv);
+    __m128d hi = _mm_max_pd(_mm_max_pd(ay, ax), _mm_set1_pd(1e-300));
+    __m128d lo = _mm_min_pd(ay, ax);
+    __m128d t = _mm_div_pd(lo, hi);
+    __m128d s = _mm_mul_pd(t, t);
+
+    const double c[] = {0.99997726, -0.33262347, 0.19354346, -0.11643287, 0.05265332, -0.01172120};
+    __m128d r = _mm_set1_pd(c[5]);
+    for (int i = 4; i >= 0; --i) {
+        r = _mm_add_pd(_mm_mul_pd(r, s), _mm_set1_pd(c[i]));
+    }
+    r = _mm_mul_pd(r, t);
+
+    r = select(_mm_cmpgt_pd(ay, ax), _mm_sub_pd(_mm_set1_pd(M_PI / 2), r), r);
+    r = select(_mm_cmplt_pd(xv, _mm_setzero_pd()), _mm_sub_pd(_mm_set1_pd(M_PI), r), r);
+    return select(_mm_cmplt_pd(yv, _mm_setzero_pd()), _mm_sub_pd(_mm_setzero_pd(), r), r);
+}
+#endif
+}
+
+void range_bearing::setOrigin(double lat, double lon) {
+    double phi = lat * DEG_TO_RAD;
+    double lambda = lon * DEG_TO_RAD;
+    sinLat = std::sin(phi);
+    cosLat = std::cos(phi);
+    sinLon = std::sin(lambda);
+    cosLon = std::cos(lambda);
+    originX = cosLat * cosLon;
+    originY = cosLat * sinLon;
+    originZ = sinLat;
+    originSet = true;
+    recomputeAll();
+}
+
+void range_bearing::update(quint32 node, double lat, double lon) {
+    if (std::isnan(lat) || std::isnan(lon)) {
+        return;
+    }
+    auto it = indexOf.constFind(node);
+    int i;
+    if (it == indexOf.constEnd()) {
+        i = int(nodes.size());
+        indexOf.insert(node, i);
+        nodes.push_back(node);
+        x.push_back(0.0);
+        y.push_back(0.0);
+        z.push_back(0.0);
+        distance.push_back(NAN);
+        bearing.push_back(NAN);
+    } else {
+        i = it.value();
+    }
+
+    double phi = lat * DEG_TO_RAD;
+    double lambda = lon * DEG_TO_RAD;
+    x[i] = std::cos(phi) * std::cos(lambda);
+    y[i] = std::cos(phi) * std::sin(lambda);
+    z[i] = std::sin(phi);
+    if (originSet) {
+        computeScalar(i, i + 1);
+    }
+}
+
+bool range_bearing::lookup(quint32 node, float& distanceKm, float& bearingDeg) const {
+    auto it = indexOf.constFind(node);
+    if (!originSet || it == indexOf.constEnd()) {
+        return false;
+    }
+    distanceKm = distance[it.value()];
+    bearingDeg = bearing[it.value()];
+    return true;
+}
+
+void range_bearing::recomputeAll() {
+    if (originSet) {
+        computeBatch(0, int(nodes.size()));
+    }
+}
+
+// Bearing uses the node's east and north components in the origin's local frame:
+// east = cos(phi2) sin(dLambda), north = cos(phi1) sin(phi2) - sin(phi1) cos(phi2) cos(dLambda)
+void range_bearing::computeScalar(int from, int to) {
+    for (int i = from; i < to; ++i) {
+        double dx = x[i] - originX;
+        double dy = y[i] - originY;
+        double dz = z[i] - originZ;
+        double halfChord = qMin(1.0, std::sqrt(dx * dx + dy * dy + dz * dz) / 2.0);
+        distance[i] = float(2.0 * EARTH_RADIUS_KM * std::asin(halfChord));
+
+        double east = y[i] * cosLon - x[i] * sinLon;
+        double north = cosLat * z[i] - sinLat * (x[i] * cosLon + y[i] * sinLon);
+        double degrees = std::atan2(east, north) * RAD_TO_DEG;
+        bearing[i] = float(degrees < 0.0 ? degrees + 360.0 : degrees);
+    }
+}
+
+#ifdef RANGE_BEARING_SSE2
+void range_bearing::computeBatch(int from, int to) {
+    const __m128d ox = _mm_set1_pd(originX);
+    const __m128d oy = _mm_set1_pd(originY);
+    const __m128d oz = _mm_set1_pd(originZ);
+    const __m128d sLat = _mm_set1_pd(sinLat);
+    const __m128d cLat = _mm_set1_pd(cosLat);
+    const __m128d sLon = _mm_set1_pd(sinLon);
+    const __m128d cLon = _mm_set1_pd(cosLon);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d diameter = _mm_set1_pd(2.0 * EARTH_RADIUS_KM);
+    const __m128d toDegrees = _mm_set1_pd(RAD_TO_DEG);
+    const __m128d fullTurn = _mm_set1_pd(360.0);
+
+    int i = from;
+    for (; i + 2 <= to; i += 2) {
+        __m128d px = _mm_loadu_pd(&x[i]);
+        __m128d py = _mm_loadu_pd(&y[i]);
+        __m128d pz = _mm_loadu_pd(&z[i]);
+
+        __m128d dx = _mm_sub_pd(px, ox);
+        __m128d dy = _mm_sub_pd(py, oy);
+        __m128d dz = _mm_sub_pd(pz, oz);
+        __m128d chord2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+        __m128d halfChord = _mm_min_pd(one, _mm_mul_pd(_mm_sqrt_pd(chord2), half));
+        __m128d km = _mm_mul_pd(diameter, asinPositive(halfChord));
+
+        __m128d east = _mm_sub_pd(_mm_mul_pd(py, cLon), _mm_mul_pd(px, sLon));
+        __m128d along = _mm_add_pd(_mm_mul_pd(px, cLon), _mm_mul_pd(py, sLon));
+        __m128d north = _mm_sub_pd(_mm_mul_pd(cLat, pz), _mm_mul_pd(sLat, along));
+        __m128d degrees = _mm_mul_pd(atan2Approx(east, north), toDegrees);
+        degrees = select(_mm_cmplt_pd(degrees, _mm_setzero_pd()), _mm_add_pd(degrees, fullTurn), degrees);
+
+        alignas(16) double lanes[2];
+        _mm_store_pd(lanes, km);
+        distance[i] = float(lanes[0]);
+        distance[i + 1] = float(lanes[1]);
+        _mm_store_pd(lanes, degrees);
+        bearing[i] = float(lanes[0]);
+        bearing[i + 1] = float(lanes[1]);
+    }
+    computeScalar(i, to);
+}
+#else
+void range_bearing::computeBatch(int from, int to) {
+    computeScalar(from, to);
+}
+#endif
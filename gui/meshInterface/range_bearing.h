@@ -0,0 +1,42 @@
+#ifndef RANGE_BEARING_H
+#define RANGE_BEARING_H
+
+#include <QHash>
+#include <vector>
+
+// Distance and bearing from our own radio to every node with a known position.
+// Positions are stored struct-of-arrays as unit vectors (x, y, z), computed once
+// per fix, so the great-circle distance needs only the chord between two vectors
+// and an arcsine; there is no cancellation for nearby nodes as with the cosine
+// forms. A new origin recomputes every node in one pass, two nodes per SSE2 step
+// with polynomial asin/atan2 whose error stays below the float precision results
+// are stored in; builds without SSE2 use the scalar loop with the std functions.
+class range_bearing
+{
+public:
+    void setOrigin(double lat, double lon);
+    bool hasOrigin() const { return originSet; }
+    // Stores the node's position and refreshes its distance and bearing
+    void update(quint32 node, double lat, double lon);
+    bool lookup(quint32 node, float& distanceKm, float& bearingDeg) const;
+    int size() const { return int(nodes.size()); }
+    // Every node's distance and bearing to the current origin
+    void recomputeAll();
+
+    const std::vector<quint32>& nodeList() const { return nodes; }
+
+private:
+    QHash<quint32, int> indexOf;
+    std::vector<quint32> nodes;
+    std::vector<double> x, y, z;
+    std::vector<float> distance, bearing;
+
+    bool originSet = false;
+    double originX = 0.0, originY = 0.0, originZ = 0.0;
+    double sinLat = 0.0, cosLat = 1.0, sinLon = 0.0, cosLon = 1.0;
+
+    void computeScalar(int from, int to);
+    void computeBatch(int from, int to);
+};
+
+#endif // RANGE_BEARING_H
@@ -0,0 +1,30 @@
+#ifndef ROUTE_TRACE_H
+#define ROUTE_TRACE_H
+
+#include <QMetaType>
+#include <QVector>
+#include <QtGlobal>
+
+// One decoded traceroute reply. Paths include both ends: forward runs from the
+// requester to the target, back from the target to the requester. Each SNR entry
+// is for the hop that ends at the same index + 1 in its path, NaN when unknown.
+struct route_trace
+{
+    qint64 timestampMs = 0;
+    quint32 requester = 0;
+    quint32 target = 0;
+    // Packet id of the request this answers, 0 if the firmware didn't report it
+    quint32 requestId = 0;
+    qint64 rttMs = -1;
+    QVector<quint32> forward;
+    QVector<float> snrTowards;
+    QVector<quint32> back;
+    QVector<float> snrBack;
+
+    int hops() const { return qMax(0, static_cast<int>(forward.size()) - 1); }
+    bool hasBack() const { return back.size() >= 2; }
+};
+
+Q_DECLARE_METATYPE(route_trace)
+
+#endif // ROUTE_TRACE_H
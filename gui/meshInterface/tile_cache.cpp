@@ -0,0 +1,383 @@
+#include "tile_cache.h"
+#include "db_connections.h"
+#include "debug_config.h"
+#include <QWebEngineUrlScheme>
+#include <QNetworkRequest>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QStandardPaths>
+#include <QPointer>
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QVector>
+#include <QPair>
+#include <QtMath>
+#include <algorithm>
+
+const QByteArray tile_cache::SCHEME = QByteArrayLiteral("meshtiles");
+
+namespace {
+const char* UPSTREAM_TILES = "https://tile.openstreetmap.org/%1/%2/%3.png";
+const char* UPSTREAM_ASSETS = "https://unpkg.com/leaflet@1.7.1/dist/";
+const char* USER_AGENT = "OpenMeshMonitor/0.1 (offline tile cache)";
+const int NETWORK_TIMEOUT_MS = 10000;
+
+int lonToTileX(double lon, int z) {
+    int n = 1 << z;
+    return std::clamp(static_cast<int>((lon + 180.0) / 360.0 * n), 0, n - 1);
+}
+
+int latToTileY(double lat, int z) {
+    int n = 1 << z;
+    lat = std::clamp(lat, -85.05112878, 85.05112878);
+    double rad = qDegreesToRadians(lat);
+    double y = (1.0 - std::log(std::tan(rad) + 1.0 / std::cos(rad)) / M_PI) / 2.0;
+    return std::clamp(static_cast<int>(y * n), 0, n - 1);
+}
+}
+
+void tile_cache::registerUrlScheme() {
+    QWebEngineUrlScheme scheme(SCHEME);
+    scheme.setSyntax(QWebEngineUrlScheme::Syntax::Host);
+    scheme.setFlags(QWebEngineUrlScheme::SecureScheme |
+                    QWebEngineUrlScheme::LocalAccessAllowed |
+                    QWebEngineUrlScheme::CorsEnabled);
+    QWebEngineUrlScheme::registerScheme(scheme);
+}
+
+tile_cache::tile_cache(QObject *parent)
+    : QWebEngineUrlSchemeHandler{parent}
+    , network(new QNetworkAccessManager(this))
+    , hotTiles(HOT_TILE_BYTES)
+    , prefetchActive(0)
+    , prefetchTotal(0)
+    , prefetchDone(0)
+    , prefetchFailed(0)
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    dbPath = dataDir + "/meshmonitor_tiles.mbtiles";
+    DEBUG_MAP("Tile cache path:" << dbPath);
+}
+
+tile_cache::~tile_cache() {
+    if (db.isOpen()) {
+        db_connections::close(db);
+    }
+}
+
+bool tile_cache::initDatabase() {
+    db = db_connections::open("tile_cache", dbPath);
+    if (!db.isOpen()) {
+        qDebug() << "Failed to open tile cache:" << db.lastError().text();
+        return false;
+    }
+
+    // Standard MBTiles layout so the file can also be filled by external tools
+    QSqlQuery query(db);
+    const char* statements[] = {
+        "CREATE TABLE IF NOT EXISTS metadata (name TEXT PRIMARY KEY, value TEXT)",
+        "CREATE TABLE IF NOT EXISTS tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB, "
+        "PRIMARY KEY (zoom_level, tile_column, tile_row))",
+        "CREATE TABLE IF NOT EXISTS assets (path TEXT PRIMARY KEY, data BLOB)",
+        "INSERT OR IGNORE INTO metadata (name, value) VALUES ('name', 'meshmonitor'), ('format', 'png')"
+    };
+    for (const char* statement : statements) {
+        if (!query.exec(statement)) {
+            qDebug() << "Failed to create tile cache tables:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+quint64 tile_cache::tileKey(int z, int x, int y) {
+    return (static_cast<quint64>(z) << 48) | (static_cast<quint64>(x) << 24) | static_cast<quint64>(y);
+}
+
+void tile_cache::tileCoords(quint64 key, int& z, int& x, int& y) {
+    z = static_cast<int>(key >> 48);
+    x = static_cast<int>((key >> 24) & 0xffffff);
+    y = static_cast<int>(key & 0xffffff);
+}
+
+QUrl tile_cache::upstreamTileUrl(int z, int x, int y) {
+    return QUrl(QString(UPSTREAM_TILES).arg(z).arg(x).arg(y));
+}
+
+QUrl tile_cache::upstreamAssetUrl(const QString& path) {
+    return QUrl(QString(UPSTREAM_ASSETS) + path);
+}
+
+QByteArray tile_cache::assetContentType(const QString& path) {
+    if (path.endsWith(".js")) return "application/javascript";
+    if (path.endsWith(".css")) return "text/css";
+    if (path.endsWith(".png")) return "image/png";
+    if (path.endsWith(".svg")) return "image/svg+xml";
+    return "application/octet-stream";
+}
+
+void tile_cache::replyWith(QWebEngineUrlRequestJob *job, const QByteArray& contentType, const QByteArray& data) {
+    QBuffer* buffer = new QBuffer(job);
+    buffer->setData(data);
+    job->reply(contentType, buffer);
+}
+
+QNetworkReply* tile_cache::fetch(const QUrl& url) {
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::UserAgentHeader, USER_AGENT);
+    request.setTransferTimeout(NETWORK_TIMEOUT_MS);
+    return network->get(request);
+}
+
+void tile_cache::requestStarted(QWebEngineUrlRequestJob *job) {
+    QUrl url = job->requestUrl();
+    QStringList parts = url.path().split('/', Qt::SkipEmptyParts);
+
+    if (url.host() == "tile" && parts.size() == 3) {
+        bool okZ, okX, okY;
+        int z = parts[0].toInt(&okZ);
+        int x = parts[1].toInt(&okX);
+        int y = QString(parts[2]).remove(".png").toInt(&okY);
+        if (okZ && okX && okY && z >= 0 && z <= 19) {
+            serveTile(job, z, x, y);
+            return;
+        }
+    } else if (url.host() == "asset" && !parts.isEmpty() && !parts.contains("..")) {
+        serveAsset(job, parts.join('/'));
+        return;
+    }
+
+    DEBUG_MAP("Invalid tile cache request:" << url);
+    job->fail(QWebEngineUrlRequestJob::UrlInvalid);
+}
+
+void tile_cache::serveTile(QWebEngineUrlRequestJob *job, int z, int x, int y) {
+    quint64 key = tileKey(z, x, y);
+
+    if (QByteArray* hot = hotTiles.object(key)) {
+        replyWith(job, "image/png", *hot);
+        return;
+    }
+
+    QByteArray data;
+    if (readTile(z, x, y, data)) {
+        hotTiles.insert(key, new QByteArray(data), data.size());
+        replyWith(job, "image/png", data);
+        return;
+    }
+
+    // Not cached yet, the job may be gone by the time the network answers
+    QPointer<QWebEngineUrlRequestJob> guard(job);
+    QNetworkReply* networkReply = fetch(upstreamTileUrl(z, x, y));
+    connect(networkReply, &QNetworkReply::finished, this, [this, guard, networkReply, key, z, x, y]() {
+        networkReply->deleteLater();
+        if (networkReply->error() != QNetworkReply::NoError) {
+            DEBUG_MAP("Tile fetch failed:" << z << x << y << networkReply->errorString());
+            if (guard) {
+                guard->fail(QWebEngineUrlRequestJob::RequestFailed);
+            }
+            return;
+        }
+        QByteArray data = networkReply->readAll();
+        storeTile(z, x, y, data);
+        hotTiles.insert(key, new QByteArray(data), data.size());
+        if (guard) {
+            replyWith(guard, "image/png", data);
+        }
+    });
+}
+
+void tile_cache::serveAsset(QWebEngineUrlRequestJob *job, const QString& path) {
+    // Leaflet itself is bundled (see leaflet.qrc.in), the cache and upstream only cover anything else
+    QFile bundled(":/leaflet/" + path);
+    if (bundled.open(QIODevice::ReadOnly)) {
+        replyWith(job, assetContentType(path), bundled.readAll());
+        return;
+    }
+
+    QByteArray data;
+    if (readAsset(path, data)) {
+        replyWith(job, assetContentType(path), data);
+        return;
+    }
+
+    QPointer<QWebEngineUrlRequestJob> guard(job);
+    QNetworkReply* networkReply = fetch(upstreamAssetUrl(path));
+    connect(networkReply, &QNetworkReply::finished, this, [this, guard, networkReply, path]() {
+        networkReply->deleteLater();
+        if (networkReply->error() != QNetworkReply::NoError) {
+            qDebug() << "Map asset unavailable offline:" << path << networkReply->errorString();
+            if (guard) {
+                guard->fail(QWebEngineUrlRequestJob::RequestFailed);
+            }
+            return;
+        }
+        QByteArray data = networkReply->readAll();
+        storeAsset(path, data);
+        if (guard) {
+            replyWith(guard, assetContentType(path), data);
+        }
+    });
+}
+
+bool tile_cache::readTile(int z, int x, int y, QByteArray& data) {
+    if (!db.isOpen()) {
+        return false;
+    }
+    QSqlQuery* query = db_connections::prepared(db, "SELECT tile_data FROM tiles WHERE zoom_level = :z AND tile_column = :x AND tile_row = :row");
+    if (!query) {
+        return false;
+    }
+    query->bindValue(":z", z);
+    query->bindValue(":x", x);
+    query->bindValue(":row", (1 << z) - 1 - y); // MBTiles rows are TMS, flipped from XYZ
+    bool found = query->exec() && query->next();
+    if (found) {
+        data = query->value(0).toByteArray();
+    }
+    query->finish();
+    return found && !data.isEmpty();
+}
+
+void tile_cache::storeTile(int z, int x, int y, const QByteArray& data) {
+    if (!db.isOpen() || data.isEmpty()) {
+        return;
+    }
+    QSqlQuery* query = db_connections::prepared(db, "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (:z, :x, :row, :data)");
+    if (!query) {
+        return;
+    }
+    query->bindValue(":z", z);
+    query->bindValue(":x", x);
+    query->bindValue(":row", (1 << z) - 1 - y);
+    query->bindValue(":data", data);
+    if (!query->exec()) {
+        qDebug() << "Failed to store tile:" << query->lastError().text();
+    }
+}
+
+bool tile_cache::readAsset(const QString& path, QByteArray& data) {
+    if (!db.isOpen()) {
+        return false;
+    }
+    QSqlQuery* query = db_connections::prepared(db, "SELECT data FROM assets WHERE path = :path");
+    if (!query) {
+        return false;
+    }
+    query->bindValue(":path", path);
+    bool found = query->exec() && query->next();
+    if (found) {
+        data = query->value(0).toByteArray();
+    }
+    query->finish();
+    return found && !data.isEmpty();
+}
+
+void tile_cache::storeAsset(const QString& path, const QByteArray& data) {
+    if (!db.isOpen() || data.isEmpty()) {
+        return;
+    }
+    QSqlQuery* query = db_connections::prepared(db, "INSERT OR REPLACE INTO assets (path, data) VALUES (:path, :data)");
+    if (!query) {
+        return;
+    }
+    query->bindValue(":path", path);
+    query->bindValue(":data", data);
+    if (!query->exec()) {
+        qDebug() << "Failed to store map asset:" << query->lastError().text();
+    }
+}
+
+bool tile_cache::prefetch(double south, double west, double north, double east, int minZoom, int maxZoom) {
+    minZoom = std::clamp(minZoom, 0, 19);
+    maxZoom = std::clamp(maxZoom, minZoom, 19);
+
+    // A box across the antimeridian has west > east (map_bridge wraps Leaflet's longitudes), it's fetched as its two halves
+    QVector<QPair<double, double>> spans;
+    if (west <= east) {
+        spans.append({west, east});
+    } else {
+        spans.append({west, 180.0});
+        spans.append({-180.0, east});
+    }
+
+    // Count first so a huge box is refused before anything is queued
+    qint64 total = 0;
+    for (int z = minZoom; z <= maxZoom; ++z) {
+        qint64 h = latToTileY(south, z) - latToTileY(north, z) + 1;
+        for (const auto& span : spans) {
+            total += (lonToTileX(span.second, z) - lonToTileX(span.first, z) + 1) * h;
+        }
+    }
+    if (total > MAX_PREFETCH_TILES) {
+        qDebug() << "Prefetch area too large:" << total << "tiles";
+        return false;
+    }
+
+    QSqlQuery* query = db_connections::prepared(db, "SELECT 1 FROM tiles WHERE zoom_level = :z AND tile_column = :x AND tile_row = :row");
+    for (int z = minZoom; z <= maxZoom; ++z) {
+        for (const auto& span : spans) {
+            for (int x = lonToTileX(span.first, z); x <= lonToTileX(span.second, z); ++x) {
+                for (int y = latToTileY(north, z); y <= latToTileY(south, z); ++y) {
+                    if (query) {
+                        query->bindValue(":z", z);
+                        query->bindValue(":x", x);
+                        query->bindValue(":row", (1 << z) - 1 - y);
+                        bool cached = query->exec() && query->next();
+                        query->finish();
+                        if (cached) {
+                            continue;
+                        }
+                    }
+                    prefetchQueue.enqueue(tileKey(z, x, y));
+                }
+            }
+        }
+    }
+
+    prefetchTotal = prefetchQueue.size() + prefetchActive;
+    prefetchDone = 0;
+    prefetchFailed = 0;
+    qDebug() << "Prefetching" << prefetchQueue.size() << "missing tiles";
+    emit prefetchProgress(prefetchDone, prefetchTotal);
+    if (prefetchTotal == 0) {
+        emit prefetchFinished(0, 0);
+        return true;
+    }
+    startNextPrefetch();
+    return true;
+}
+
+void tile_cache::cancelPrefetch() {
+    prefetchQueue.clear();
+}
+
+// Only a couple of requests at a time, the OSM tile servers don't allow bulk scraping
+void tile_cache::startNextPrefetch() {
+    while (prefetchActive < MAX_PREFETCH_REQUESTS && !prefetchQueue.isEmpty()) {
+        quint64 key = prefetchQueue.dequeue();
+        int z, x, y;
+        tileCoords(key, z, x, y);
+
+        prefetchActive++;
+        QNetworkReply* networkReply = fetch(upstreamTileUrl(z, x, y));
+        connect(networkReply, &QNetworkReply::finished, this, [this, networkReply, z, x, y]() {
+            networkReply->deleteLater();
+            prefetchActive--;
+            prefetchDone++;
+            if (networkReply->error() == QNetworkReply::NoError) {
+                storeTile(z, x, y, networkReply->readAll());
+            } else {
+                prefetchFailed++;
+            }
+            emit prefetchProgress(prefetchDone, prefetchTotal);
+
+            if (prefetchQueue.isEmpty() && prefetchActive == 0) {
+                emit prefetchFinished(prefetchDone - prefetchFailed, prefetchFailed);
+            } else {
+                startNextPrefetch();
+            }
+        });
+    }
+}
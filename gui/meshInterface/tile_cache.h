@@ -0,0 +1,73 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <QWebEngineUrlSchemeHandler>
+#include <QWebEngineUrlRequestJob>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSqlDatabase>
+#include <QCache>
+#include <QQueue>
+
+// Serves map tiles (meshtiles://tile/z/x/y.png) and the Leaflet assets
+// (meshtiles://asset/...) to map.html. Leaflet is compiled in as a Qt resource.
+// Tile lookups go to an in-memory LRU of hot tiles first, then the on-disk
+// MBTiles cache, and only fall back to the network on a miss, storing whatever
+// comes back for offline use.
+class tile_cache : public QWebEngineUrlSchemeHandler
+{
+    Q_OBJECT
+public:
+    static const QByteArray SCHEME;
+
+    // Must be called before the QApplication is created
+    static void registerUrlScheme();
+
+    explicit tile_cache(QObject *parent = nullptr);
+    ~tile_cache();
+
+    bool initDatabase();
+    void requestStarted(QWebEngineUrlRequestJob *job) override;
+
+    // Download every missing tile in the box ahead of time, returns false if the area is too big
+    bool prefetch(double south, double west, double north, double east, int minZoom, int maxZoom);
+    void cancelPrefetch();
+
+signals:
+    void prefetchProgress(int done, int total);
+    void prefetchFinished(int fetched, int failed);
+
+private:
+    static const int MAX_PREFETCH_TILES = 20000;
+    static const int MAX_PREFETCH_REQUESTS = 2;
+    static const int HOT_TILE_BYTES = 32 * 1024 * 1024;
+
+    QString dbPath;
+    QSqlDatabase db;
+    QNetworkAccessManager* network;
+    QCache<quint64, QByteArray> hotTiles;
+
+    QQueue<quint64> prefetchQueue;
+    int prefetchActive;
+    int prefetchTotal;
+    int prefetchDone;
+    int prefetchFailed;
+
+    static quint64 tileKey(int z, int x, int y);
+    static void tileCoords(quint64 key, int& z, int& x, int& y);
+    static QUrl upstreamTileUrl(int z, int x, int y);
+    static QUrl upstreamAssetUrl(const QString& path);
+    static QByteArray assetContentType(const QString& path);
+
+    void serveTile(QWebEngineUrlRequestJob *job, int z, int x, int y);
+    void serveAsset(QWebEngineUrlRequestJob *job, const QString& path);
+    bool readTile(int z, int x, int y, QByteArray& data);
+    void storeTile(int z, int x, int y, const QByteArray& data);
+    bool readAsset(const QString& path, QByteArray& data);
+    void storeAsset(const QString& path, const QByteArray& data);
+    QNetworkReply* fetch(const QUrl& url);
+    static void replyWith(QWebEngineUrlRequestJob *job, const QByteArray& contentType, const QByteArray& data);
+    void startNextPrefetch();
+};
+
+#endif // TILE_CACHE_H
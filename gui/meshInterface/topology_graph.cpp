@@ -0,0 +1,319 @@
+#include "topology_graph.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace {
+const double UNREACHABLE = std::numeric_limits<double>::infinity();
+const float SNR_ALPHA = 0.3f;
+}
+
+quint64 topology_graph::edgeKey(quint32 a, quint32 b) {
+    if (a > b) {
+        std::swap(a, b);
+    }
+    return (quint64(a) << 32) | b;
+}
+
+// A good link (SNR >= 10 dB) costs 1, a link at the decode floor (-20 dB) about 3,
+// and every DECAY_MS of silence multiplies the cost by e
+double topology_graph::snrFactor(float snr) {
+    double value = std::isnan(snr) ? -5.0 : snr;
+    return 1.0 + qBound(0.0, (10.0 - value) / 15.0, 2.0);
+}
+
+double topology_graph::edgeCost(const Edge& edge, qint64 nowMs) {
+    double age = qMax<qint64>(0, nowMs - edge.lastSeenMs);
+    return snrFactor(edge.snr) * std::exp(age / double(DECAY_MS));
+}
+
+void topology_graph::remember(quint32 node) {
+    QVector<quint32>& sameByte = byLowByte[int(node & 0xff)];
+    if (!sameByte.contains(node)) {
+        sameByte.append(node);
+    }
+}
+
+void topology_graph::touch(quint32 a, quint32 b, float snr, qint64 timestampMs, int source) {
+    if (a == b) {
+        return;
+    }
+    remember(a);
+    remember(b);
+
+    Edge& edge = edgeMap[edgeKey(a, b)];
+    bool isNew = edge.observations == 0;
+    if (isNew) {
+        edge.a = qMin(a, b);
+        edge.b = qMax(a, b);
+    }
+    if (!std::isnan(snr)) {
+        edge.snr = std::isnan(edge.snr) ? snr : edge.snr + SNR_ALPHA * (snr - edge.snr);
+    }
+    edge.lastSeenMs = qMax(edge.lastSeenMs, timestampMs);
+    edge.sources |= source;
+    edge.observations++;
+
+    // Quarter steps of the SNR factor; anything finer only waits for the next timed rebuild
+    int bucket = int(std::lround(snrFactor(edge.snr) * 4.0));
+    if (isNew || bucket != edge.costBucket) {
+        edge.costBucket = bucket;
+        changes++;
+    }
+}
+
+void topology_graph::setLocalNode(quint32 num) {
+    if (num == local || num == LOCAL) {
+        return;
+    }
+    // Move every edge recorded against the placeholder over to the real number
+    QVector<Edge> moved;
+    for (auto it = edgeMap.begin(); it != edgeMap.end();) {
+        if (it->a == local || it->b == local) {
+            moved.append(it.value());
+            it = edgeMap.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    quint32 old = local;
+    local = num;
+    byLowByte[int(old & 0xff)].removeAll(old);
+    for (const Edge& edge : moved) {
+        quint32 other = edge.a == old ? edge.b : edge.a;
+        // An edge to our own number would be a self-loop, touch() never records one
+        if (other == local) {
+            continue;
+        }
+        Edge& target = edgeMap[edgeKey(local, other)];
+        if (target.observations == 0) {
+            target = edge;
+        } else {
+            // Already heard under the real number too, keep both histories
+            target.lastSeenMs = qMax(target.lastSeenMs, edge.lastSeenMs);
+            target.sources |= edge.sources;
+            target.observations += edge.observations;
+            if (std::isnan(target.snr)) {
+                target.snr = edge.snr;
+            }
+        }
+        target.a = qMin(local, other);
+        target.b = qMax(local, other);
+    }
+    hops.remove(local);
+    remember(local);
+    changes++;
+}
+
+// The firmware only gives the relay's low byte; it is resolved only when exactly
+// one known node matches, preferring nodes we hear directly
+quint32 topology_graph::resolveRelay(int relayByte, quint32 sender) const {
+    quint32 found = 0;
+    int matches = 0;
+    for (quint32 candidate : byLowByte.value(relayByte)) {
+        if (candidate == sender || candidate == local) {
+            continue;
+        }
+        if (hops.value(candidate).hops == 0) {
+            return candidate;
+        }
+        found = candidate;
+        matches++;
+    }
+    return matches == 1 ? found : 0;
+}
+
+void topology_graph::addEvent(const mesh_event& event) {
+    int away = event.hopsAway();
+    if (event.from == 0 || event.from == local || away < 0) {
+        return;
+    }
+    // Every copy is fed in, duplicates included; a rebroadcast copy must not make a direct node look relayed
+    Heard& heard = hops[event.from];
+    if (event.packetId == 0 || event.packetId != heard.packetId || away < heard.hops) {
+        heard.packetId = event.packetId;
+        heard.hops = away;
+    }
+    remember(event.from);
+
+    if (away == 0) {
+        touch(local, event.from, event.rxSnr, event.timestampMs, HeardDirect);
+        return;
+    }
+    if (event.relayNode < 0) {
+        return;
+    }
+    // What we received came straight from the relay, so rxSnr belongs to that link
+    quint32 relay = resolveRelay(event.relayNode, event.from);
+    if (relay == 0) {
+        return;
+    }
+    touch(local, relay, event.rxSnr, event.timestampMs, RelayHint);
+    if (away == 1) {
+        touch(relay, event.from, NAN, event.timestampMs, RelayHint);
+    }
+}
+
+void topology_graph::addNeighborInfo(quint32 node, const QVector<QPair<quint32, float>>& neighbors, qint64 timestampMs) {
+    for (const auto& neighbor : neighbors) {
+        touch(node, neighbor.first, neighbor.second, timestampMs, NeighborReport);
+    }
+}
+
+void topology_graph::addRoute(const QVector<quint32>& path, const QVector<float>& snrs, qint64 timestampMs) {
+    for (int i = 0; i + 1 < path.size(); ++i) {
+        touch(path[i], path[i + 1], i < snrs.size() ? snrs[i] : NAN, timestampMs, RoutePath);
+    }
+}
+
+void topology_graph::ensureCache(qint64 nowMs) {
+    if (cache.version == changes && nowMs - cache.builtMs < CACHE_MS) {
+        return;
+    }
+
+    // Forget links nobody has confirmed for a while
+    for (auto it = edgeMap.begin(); it != edgeMap.end();) {
+        if (nowMs - it->lastSeenMs > MAX_AGE_MS) {
+            it = edgeMap.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    cache = Cache();
+    for (const Edge& edge : std::as_const(edgeMap)) {
+        for (quint32 node : {edge.a, edge.b}) {
+            if (!cache.indexOf.contains(node)) {
+                cache.indexOf.insert(node, cache.nodes.size());
+                cache.nodes.append(node);
+            }
+        }
+    }
+    cache.adjacency.resize(cache.nodes.size());
+    for (const Edge& edge : std::as_const(edgeMap)) {
+        int a = cache.indexOf.value(edge.a);
+        int b = cache.indexOf.value(edge.b);
+        double cost = edgeCost(edge, nowMs);
+        cache.adjacency[a].append(qMakePair(b, cost));
+        cache.adjacency[b].append(qMakePair(a, cost));
+    }
+    cache.version = changes;
+    cache.builtMs = nowMs;
+}
+
+const topology_graph::Tree& topology_graph::tree(int source) {
+    auto it = cache.trees.constFind(source);
+    if (it != cache.trees.constEnd()) {
+        return it.value();
+    }
+
+    // Dijkstra over the cached adjacency
+    int n = cache.nodes.size();
+    Tree result;
+    result.cost.fill(UNREACHABLE, n);
+    result.previous.fill(-1, n);
+    using Entry = QPair<double, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    result.cost[source] = 0.0;
+    queue.push(qMakePair(0.0, source));
+    while (!queue.empty()) {
+        Entry top = queue.top();
+        queue.pop();
+        int v = top.second;
+        if (top.first > result.cost[v]) {
+            continue;
+        }
+        for (const auto& next : cache.adjacency[v]) {
+            double cost = top.first + next.second;
+            if (cost < result.cost[next.first]) {
+                result.cost[next.first] = cost;
+                result.previous[next.first] = v;
+                queue.push(qMakePair(cost, next.first));
+            }
+        }
+    }
+    return cache.trees.insert(source, result).value();
+}
+
+QVector<quint32> topology_graph::shortestPath(quint32 from, quint32 to, qint64 nowMs) {
+    ensureCache(nowMs);
+    QVector<quint32> path;
+    if (!cache.indexOf.contains(from) || !cache.indexOf.contains(to)) {
+        return path;
+    }
+
+    const Tree& t = tree(cache.indexOf.value(from));
+    int target = cache.indexOf.value(to);
+    if (t.cost[target] == UNREACHABLE) {
+        return path;
+    }
+    for (int v = target; v != -1; v = t.previous[v]) {
+        path.prepend(cache.nodes[v]);
+    }
+    return path;
+}
+
+QVector<quint32> topology_graph::articulationPoints(qint64 nowMs) {
+    ensureCache(nowMs);
+    if (cache.articulationValid) {
+        return cache.articulation;
+    }
+
+    // Iterative Tarjan: discovery time and low-link per vertex, with an explicit stack
+    int n = cache.nodes.size();
+    QVector<int> discovered(n, -1);
+    QVector<int> low(n, 0);
+    QVector<int> parent(n, -1);
+    QVector<int> nextEdge(n, 0);
+    QVector<bool> isCut(n, false);
+    int time = 0;
+
+    for (int root = 0; root < n; ++root) {
+        if (discovered[root] != -1) {
+            continue;
+        }
+        int rootChildren = 0;
+        QVector<int> stack{root};
+        discovered[root] = low[root] = time++;
+
+        while (!stack.isEmpty()) {
+            int v = stack.last();
+            if (nextEdge[v] < cache.adjacency[v].size()) {
+                int w = cache.adjacency[v][nextEdge[v]++].first;
+                if (discovered[w] == -1) {
+                    parent[w] = v;
+                    discovered[w] = low[w] = time++;
+                    if (v == root) {
+                        rootChildren++;
+                    }
+                    stack.append(w);
+                } else if (w != parent[v]) {
+                    low[v] = qMin(low[v], discovered[w]);
+                }
+                continue;
+            }
+
+            stack.removeLast();
+            int p = parent[v];
+            if (p != -1) {
+                low[p] = qMin(low[p], low[v]);
+                if (p != root && low[v] >= discovered[p]) {
+                    isCut[p] = true;
+                }
+            }
+        }
+        if (rootChildren > 1) {
+            isCut[root] = true;
+        }
+    }
+
+    for (int v = 0; v < n; ++v) {
+        if (isCut[v]) {
+            cache.articulation.append(cache.nodes[v]);
+        }
+    }
+    cache.articulationValid = true;
+    return cache.articulation;
+}
@@ -0,0 +1,97 @@
+#ifndef TOPOLOGY_GRAPH_H
+#define TOPOLOGY_GRAPH_H
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include "mesh_event.h"
+
+// Undirected mesh graph assembled from everything that reveals a link:
+// zero-hop packets (local radio <-> sender, weighted by rxSnr), the relay byte on
+// relayed packets, NeighborInfo reports and traceroute paths. Edge cost grows as
+// SNR drops and as the edge ages, and edges unseen for MAX_AGE_MS are dropped.
+// Adjacency, articulation points and per-source shortest-path trees are built
+// lazily and reused until an edge appears or disappears, an edge's SNR moves it
+// to another cost bucket, or CACHE_MS passes (ages move costs). Repeat
+// observations of a known link only refresh it in place.
+class topology_graph
+{
+public:
+    // Stands in for the attached radio until its node number is known
+    static const quint32 LOCAL = 0;
+    static const qint64 DECAY_MS = 30 * 60 * 1000;
+    static const qint64 MAX_AGE_MS = 6 * 60 * 60 * 1000;
+    static const qint64 CACHE_MS = 30 * 1000;
+
+    enum Source {
+        HeardDirect = 1,
+        RelayHint = 2,
+        NeighborReport = 4,
+        RoutePath = 8
+    };
+
+    struct Edge {
+        quint32 a = 0;
+        quint32 b = 0;
+        float snr = NAN;
+        qint64 lastSeenMs = 0;
+        int sources = 0;
+        int observations = 0;
+        int costBucket = -1;
+    };
+
+    void setLocalNode(quint32 num);
+    quint32 localNode() const { return local; }
+
+    void addEvent(const mesh_event& event);
+    void addNeighborInfo(quint32 node, const QVector<QPair<quint32, float>>& neighbors, qint64 timestampMs);
+    // snrs[i] is the SNR of the hop path[i] -> path[i + 1], NaN when unknown
+    void addRoute(const QVector<quint32>& path, const QVector<float>& snrs, qint64 timestampMs);
+
+    static double edgeCost(const Edge& edge, qint64 nowMs);
+
+    // Cheapest path including both ends, empty when they aren't connected
+    QVector<quint32> shortestPath(quint32 from, quint32 to, qint64 nowMs);
+    // Nodes whose loss would split the mesh
+    QVector<quint32> articulationPoints(qint64 nowMs);
+
+private:
+    struct Tree {
+        QVector<double> cost;
+        QVector<int> previous;
+    };
+
+    struct Cache {
+        quint64 version = ~quint64(0);
+        qint64 builtMs = 0;
+        QVector<quint32> nodes;
+        QHash<quint32, int> indexOf;
+        QVector<QVector<QPair<int, double>>> adjacency;
+        QVector<quint32> articulation;
+        bool articulationValid = false;
+        QHash<int, Tree> trees;
+    };
+
+    QHash<quint64, Edge> edgeMap;
+    // Hops of the latest packet from each node, the fewest over all copies of it heard
+    struct Heard {
+        quint32 packetId = 0;
+        int hops = -1;
+    };
+    QHash<quint32, Heard> hops;
+    // Known nodes by their low byte, to resolve relay hints
+    QHash<int, QVector<quint32>> byLowByte;
+    quint32 local = LOCAL;
+    quint64 changes = 0;
+    Cache cache;
+
+    static quint64 edgeKey(quint32 a, quint32 b);
+    static double snrFactor(float snr);
+    void remember(quint32 node);
+    void touch(quint32 a, quint32 b, float snr, qint64 timestampMs, int source);
+    quint32 resolveRelay(int relayByte, quint32 sender) const;
+    void ensureCache(qint64 nowMs);
+    const Tree& tree(int source);
+};
+
+#endif // TOPOLOGY_GRAPH_H
@@ -0,0 +1,184 @@
+#include "traceroute_tracker.h"
+#include <QDateTime>
+#include <QRandomGenerator>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+const int TICK_MS = 5000;
+
+double meanSnr(const QVector<float>& snrs) {
+    double sum = 0.0;
+    int n = 0;
+    for (float snr : snrs) {
+        if (!std::isnan(snr)) {
+            sum += snr;
+            n++;
+        }
+    }
+    return n ? sum / n : NAN;
+}
+}
+
+traceroute_tracker::traceroute_tracker(QObject *parent)
+    : QObject{parent}
+{
+    timer = new QTimer(this);
+    timer->setInterval(TICK_MS);
+    connect(timer, &QTimer::timeout, this, &traceroute_tracker::tick);
+    timer->start();
+}
+
+void traceroute_tracker::setWatched(quint32 node, bool watch) {
+    if (watch) {
+        watched.insert(node);
+    } else {
+        watched.remove(node);
+    }
+}
+
+void traceroute_tracker::setActive(bool sessionActive) {
+    active = sessionActive;
+    if (!active) {
+        urgent.clear();
+        inFlight.clear();
+        sendOrder.clear();
+    }
+}
+
+void traceroute_tracker::onSendFailed(quint32 target, quint32 packetId) {
+    auto it = inFlight.find(packetId);
+    if (it != inFlight.end() && it->target == target) {
+        inFlight.erase(it);
+    }
+}
+
+void traceroute_tracker::traceNow(quint32 node) {
+    if (!active) {
+        return;
+    }
+    if (!urgent.contains(node)) {
+        urgent.enqueue(node);
+    }
+    tick();
+}
+
+void traceroute_tracker::tick() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    expire(now);
+    if (!active || now - lastSentMs < MIN_INTERVAL_MS) {
+        return;
+    }
+
+    if (!urgent.isEmpty()) {
+        send(urgent.dequeue(), now);
+        return;
+    }
+
+    // Least recently traced watched node that is due
+    quint32 next = 0;
+    qint64 oldest = now - TARGET_INTERVAL_MS;
+    for (quint32 node : std::as_const(watched)) {
+        qint64 sent = history.value(node).lastSentMs;
+        if (sent <= oldest) {
+            oldest = sent;
+            next = node;
+        }
+    }
+    if (next != 0) {
+        send(next, now);
+    }
+}
+
+void traceroute_tracker::send(quint32 target, qint64 nowMs) {
+    quint32 packetId;
+    do {
+        packetId = QRandomGenerator::global()->generate();
+    } while (packetId == 0 || inFlight.contains(packetId));
+
+    inFlight.insert(packetId, Pending{target, nowMs});
+    sendOrder.enqueue(qMakePair(packetId, nowMs));
+    history[target].lastSentMs = nowMs;
+    lastSentMs = nowMs;
+    emit requestTrace(target, packetId);
+}
+
+// Answered requests are already gone from the hash, so their FIFO entries are just skipped
+void traceroute_tracker::expire(qint64 nowMs) {
+    while (!sendOrder.isEmpty() && nowMs - sendOrder.head().second >= TIMEOUT_MS) {
+        QPair<quint32, qint64> oldest = sendOrder.dequeue();
+        auto it = inFlight.find(oldest.first);
+        if (it != inFlight.end() && it->sentMs == oldest.second) {
+            quint32 target = it->target;
+            inFlight.erase(it);
+            qDebug() << "Traceroute to" << Qt::hex << target << "timed out";
+            emit traceTimedOut(target, oldest.first);
+        }
+    }
+}
+
+void traceroute_tracker::onRouteReply(const route_trace& trace) {
+    route_trace result = trace;
+    auto it = inFlight.find(trace.requestId);
+    if (trace.requestId != 0 && it != inFlight.end()) {
+        result.rttMs = trace.timestampMs - it->sentMs;
+        inFlight.erase(it);
+    }
+
+    History& h = history[result.target];
+    if (h.traces.size() < HISTORY) {
+        h.traces.append(result);
+    } else {
+        h.traces[h.next] = result;
+    }
+    h.next = (h.next + 1) % HISTORY;
+    emit traceCompleted(result);
+}
+
+route_stats traceroute_tracker::stats(quint32 target) const {
+    route_stats result;
+    auto it = history.constFind(target);
+    if (it == history.constEnd() || it->traces.isEmpty()) {
+        return result;
+    }
+    const History& h = it.value();
+    result.traces = h.traces.size();
+
+    QHash<QVector<quint32>, int> pathCounts;
+    int mostCommon = 0;
+    int withBack = 0;
+    int asymmetric = 0;
+    double imbalance = 0.0;
+    int imbalanceCount = 0;
+    QVector<qint64> rtts;
+    for (const route_trace& trace : h.traces) {
+        mostCommon = qMax(mostCommon, ++pathCounts[trace.forward]);
+        if (trace.hasBack()) {
+            withBack++;
+            QVector<quint32> reversed(trace.back.crbegin(), trace.back.crend());
+            if (reversed != trace.forward) {
+                asymmetric++;
+            }
+            double diff = meanSnr(trace.snrTowards) - meanSnr(trace.snrBack);
+            if (!std::isnan(diff)) {
+                imbalance += diff;
+                imbalanceCount++;
+            }
+        }
+        if (trace.rttMs >= 0) {
+            rtts.append(trace.rttMs);
+        }
+    }
+
+    result.stability = double(mostCommon) / result.traces;
+    result.asymmetry = withBack ? double(asymmetric) / withBack : 0.0;
+    result.snrImbalance = imbalanceCount ? imbalance / imbalanceCount : NAN;
+    const route_trace& latest = h.traces[(h.next + h.traces.size() - 1) % h.traces.size()];
+    result.lastRttMs = latest.rttMs;
+    if (!rtts.isEmpty()) {
+        auto middle = rtts.begin() + rtts.size() / 2;
+        std::nth_element(rtts.begin(), middle, rtts.end());
+        result.medianRttMs = *middle;
+    }
+    return result;
+}
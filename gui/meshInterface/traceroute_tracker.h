@@ -0,0 +1,93 @@
+#ifndef TRACEROUTE_TRACKER_H
+#define TRACEROUTE_TRACKER_H
+
+#include <QObject>
+#include <QHash>
+#include <QPair>
+#include <QQueue>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+#include <cmath>
+#include "route_trace.h"
+
+struct route_stats
+{
+    int traces = 0;
+    // Share of recent traces that took the most common forward path
+    double stability = 0.0;
+    // Share of recent traces whose way back differs from the way out
+    double asymmetry = 0.0;
+    // Mean forward SNR minus mean return SNR, in dB
+    double snrImbalance = NAN;
+    qint64 lastRttMs = -1;
+    qint64 medianRttMs = -1;
+};
+
+// Sends periodic traceroutes to the nodes it is asked to watch and matches the
+// replies to their requests. Requests are spaced MIN_INTERVAL_MS apart and each
+// target is traced at most once per TARGET_INTERVAL_MS, the least recently traced
+// first. In-flight requests sit in a hash keyed by packet id (O(1) matching) and a
+// FIFO in send order; since every request has the same timeout, the FIFO is also
+// deadline order and expiry only ever looks at its head. Nothing is sent while the
+// tracker is inactive (no API session), and a request the radio refused is dropped
+// from the in-flight set straight away instead of timing out.
+class traceroute_tracker : public QObject
+{
+    Q_OBJECT
+public:
+    static const int MIN_INTERVAL_MS = 30 * 1000;
+    static const int TARGET_INTERVAL_MS = 15 * 60 * 1000;
+    static const int TIMEOUT_MS = 2 * 60 * 1000;
+    static const int HISTORY = 16;
+
+    explicit traceroute_tracker(QObject *parent = nullptr);
+
+    bool isWatched(quint32 node) const { return watched.contains(node); }
+    bool isActive() const { return active; }
+    int inFlightCount() const { return inFlight.size(); }
+    route_stats stats(quint32 target) const;
+
+public slots:
+    void setWatched(quint32 node, bool watch);
+    // Queues a trace ahead of the schedule, still subject to MIN_INTERVAL_MS
+    void traceNow(quint32 node);
+    void onRouteReply(const route_trace& trace);
+    // Pending requests can't be answered once the session is gone, they are dropped
+    void setActive(bool sessionActive);
+    void onSendFailed(quint32 target, quint32 packetId);
+
+signals:
+    void requestTrace(quint32 target, quint32 packetId);
+    void traceCompleted(const route_trace& trace);
+    void traceTimedOut(quint32 target, quint32 packetId);
+
+private slots:
+    void tick();
+
+private:
+    struct Pending {
+        quint32 target = 0;
+        qint64 sentMs = 0;
+    };
+
+    struct History {
+        QVector<route_trace> traces;
+        int next = 0;
+        qint64 lastSentMs = 0;
+    bool active = false;
+    };
+
+    QTimer* timer;
+    QSet<quint32> watched;
+    QQueue<quint32> urgent;
+    QHash<quint32, History> history;
+    QHash<quint32, Pending> inFlight;
+    QQueue<QPair<quint32, qint64>> sendOrder;
+    qint64 lastSentMs = 0;
+
+    void send(quint32 target, qint64 nowMs);
+    void expire(qint64 nowMs);
+};
+
+#endif // TRACEROUTE_TRACKER_H
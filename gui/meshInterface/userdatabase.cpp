@@ -1,4 +1,5 @@
 #include "userdatabase.h"
+#include "db_connections.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QCryptographicHash>
@@ -10,23 +11,21 @@
 userdatabase::userdatabase(QObject *parent)
     : QObject{parent}
 {
-    db = QSqlDatabase::addDatabase("QSQLITE");
     QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    QDir().mkpath(dataDir);
-    QString dbPath = dataDir + "/meshmonitor_users.db";
-    db.setDatabaseName(dbPath);
+    dbPath = dataDir + "/meshmonitor_users.db";
     //Delete at somepoint
     qDebug() << "Database path:" << dbPath;
 }
 
 userdatabase::~userdatabase() {
     if(db.isOpen()) {
-        db.close();
+        db_connections::close(db);
     }
 }
 
 bool userdatabase::initDatabase() {
-    if (!db.open()) {
+    db = db_connections::open("users", dbPath);
+    if (!db.isOpen()) {
         qDebug() << "Failed to open database:" << db.lastError().text();
         emit databaseError("Failed to open database: " + db.lastError().text());
         return false;
@@ -57,8 +56,11 @@ bool userdatabase::addUser(const QString &username, const QString &password) {
         return false;
     }
 
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO users (username, password_hash) VALUES (:username, :password_hash)");
+    QSqlQuery* statement = db_connections::prepared(db, "INSERT INTO users (username, password_hash) VALUES (:username, :password_hash)");
+    if (!statement) {
+        return false;
+    }
+    QSqlQuery& query = *statement;
     query.bindValue(":username", username);
     query.bindValue(":password_hash", hashPassword(password));
 
@@ -74,8 +76,11 @@ bool userdatabase::addUser(const QString &username, const QString &password) {
 }
 
 bool userdatabase::authenticateUser(const QString &username, const QString &password) {
-    QSqlQuery query(db);
-    query.prepare("SELECT password_hash FROM users WHERE username = :username");
+    QSqlQuery* statement = db_connections::prepared(db, "SELECT password_hash FROM users WHERE username = :username");
+    if (!statement) {
+        return false;
+    }
+    QSqlQuery& query = *statement;
     query.bindValue(":username", username);
 
     if (!query.exec()) {
@@ -85,6 +90,7 @@ bool userdatabase::authenticateUser(const QString &username, const QString &pass
 
     if (query.next()) {
         QString storedHash = query.value("password_hash").toString();
+        query.finish();
         return verifyPassword(password, storedHash);
     }
 
@@ -93,8 +99,11 @@ bool userdatabase::authenticateUser(const QString &username, const QString &pass
 }
 
 bool userdatabase::updateUser(const QString &username, const QString &password) {
-    QSqlQuery query(db);
-    query.prepare("UPDATE users SET password_hash = :password_hash WHERE username = :username");
+    QSqlQuery* statement = db_connections::prepared(db, "UPDATE users SET password_hash = :password_hash WHERE username = :username");
+    if (!statement) {
+        return false;
+    }
+    QSqlQuery& query = *statement;
     query.bindValue(":username", username);
     query.bindValue(":password_hash", hashPassword(password));
 
@@ -115,8 +124,11 @@ bool userdatabase::deleteUser(const QString &username, const QString &password)
         return false;
     }
 
-    QSqlQuery query(db);
-    query.prepare("DELETE FROM users WHERE username = :username");
+    QSqlQuery* statement = db_connections::prepared(db, "DELETE FROM users WHERE username = :username");
+    if (!statement) {
+        return false;
+    }
+    QSqlQuery& query = *statement;
     query.bindValue(":username", username);
 
     if (!query.exec()) {
@@ -136,8 +148,11 @@ bool userdatabase::changePassword(const QString &username, const QString &passwo
         return false;
     }
 
-    QSqlQuery query(db);
-    query.prepare("UPDATE users SET password_hash = :password_hash WHERE username = :username");
+    QSqlQuery* statement = db_connections::prepared(db, "UPDATE users SET password_hash = :password_hash WHERE username = :username");
+    if (!statement) {
+        return false;
+    }
+    QSqlQuery& query = *statement;
     query.bindValue(":username", username);
     query.bindValue(":password_hash", hashPassword(newPassword));
 
@@ -153,14 +168,18 @@ bool userdatabase::changePassword(const QString &username, const QString &passwo
 
 User userdatabase::getUser(const QString &username) {
     User user;
-    QSqlQuery query(db);
-    query.prepare("SELECT username, password_hash FROM users WHERE username = :username");
+    QSqlQuery* statement = db_connections::prepared(db, "SELECT username, password_hash FROM users WHERE username = :username");
+    if (!statement) {
+        return user;
+    }
+    QSqlQuery& query = *statement;
     query.bindValue(":username", username);
 
     if (query.exec() && query.next()) {
         user.username = query.value("username").toString();
         user.passwordHash = query.value("password_hash").toString();
     }
+    query.finish();
 
     return user;
 }
@@ -181,15 +200,16 @@ QList<User> userdatabase::getAllUsers() {
 }
 
 bool userdatabase::userExists(const QString &username) {
-    QSqlQuery query(db);
-    query.prepare("SELECT COUNT(*) FROM users WHERE username = :username");
-    query.bindValue(":username", username);
-
-    if (query.exec() && query.next()) {
-        return query.value(0).toInt() > 0;
+    QSqlQuery* statement = db_connections::prepared(db, "SELECT COUNT(*) FROM users WHERE username = :username");
+    if (!statement) {
+        return false;
     }
+    QSqlQuery& query = *statement;
+    query.bindValue(":username", username);
 
-    return false;
+    bool exists = query.exec() && query.next() && query.value(0).toInt() > 0;
+    query.finish();
+    return exists;
 }
 
 QString userdatabase::hashPassword(const QString &password) {
@@ -39,6 +39,7 @@ public:
     bool verifyPassword(const QString &password, const QString &hash);
 
 private:
+    QString dbPath;
     QSqlDatabase db;
     bool createTables();
     QString generateSalt();